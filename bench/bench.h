@@ -0,0 +1,90 @@
+/*  =========================================================================
+    bench - Helpers shared by benchmarks of the engine
+
+    Copyright (C) 2014 - 2021 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+
+#include "src/autoconfig.h"
+#include "src/templateruleconfigurator.h"
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#ifndef BENCH_SOURCE_DIR
+#define BENCH_SOURCE_DIR "."
+#endif
+
+namespace bench {
+
+/// Path of a file of the source tree (test rules, rule templates)
+inline std::string sourcePath(const std::string& path)
+{
+    return std::string(BENCH_SOURCE_DIR) + "/" + path;
+}
+
+/// Content of a file of the source tree
+inline std::string readSource(const std::string& path)
+{
+    std::ifstream f(sourcePath(path));
+    return std::string((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+}
+
+/// Current time as metrics are stamped by the engine
+inline uint64_t now()
+{
+    return static_cast<uint64_t>(::time(nullptr));
+}
+
+/// Empty directory for rules saved by AlertConfiguration
+inline std::string emptyDir(const std::string& name)
+{
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / ("fty-alert-engine-bench-" + name);
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    return dir.string();
+}
+
+/// Points autoconfig to the templates of the source tree
+inline void useSourceTemplates()
+{
+    Autoconfig::RuleFilePath = sourcePath("src/rule_templates");
+    // phases are read from SHM, there is none here
+    gDisable_ruleXphaseIsApplicable = true;
+}
+
+/// UPS as autoconfig gets it from fty-asset
+/// @param[in] i - index of the device, makes the name unique
+/// @param[out] name - iname of the device
+inline AutoConfigurationInfo upsDevice(size_t i, std::string& name)
+{
+    name = "ups-" + std::to_string(i + 1);
+
+    AutoConfigurationInfo info;
+    info.type                        = "device";
+    info.subtype                     = "ups";
+    info.operation                   = FTY_PROTO_ASSET_OP_CREATE;
+    info.attributes["name"]          = "UPS " + std::to_string(i + 1);
+    info.attributes["logical_asset"] = "datacenter-1";
+    info.attributes["model"]         = "9PX 6000";
+    return info;
+}
+
+} // namespace bench
@@ -0,0 +1,204 @@
+/*  =========================================================================
+    macro - Benchmarks of whole polling cycles and device onboarding
+
+    Copyright (C) 2014 - 2021 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#include "bench.h"
+#include "src/alertconfiguration.h"
+#include "src/metriclist.h"
+#include "src/rulechannel.h"
+#include "src/templateruleconfigurator.h"
+#include <benchmark/benchmark.h>
+#include <map>
+#include <memory>
+#include <sstream>
+
+/// Rules generated from the templates for a number of UPS, with the metrics they need
+struct Engine
+{
+    AlertConfiguration      ac;
+    std::vector<MetricInfo> metrics; // one for every topic needed by the rules
+    size_t                  rules = 0;
+
+    Engine(size_t devices)
+        : ac(bench::emptyDir("cycle-" + std::to_string(devices)))
+    {
+        bench::useSourceTemplates();
+
+        TemplateRuleConfigurator configurator;
+        GeneratedRules           generated;
+        RenderedRules            rendered;
+        std::set<std::string>    topics;
+        for (size_t i = 0; i < devices; i++) {
+            std::string           name;
+            AutoConfigurationInfo info = bench::upsDevice(i, name);
+            configurator.render(name, info, "Datacenter 1", generated, rendered);
+
+            for (const auto& r : rendered) {
+                if (r.flexible) {
+                    continue;
+                }
+                std::istringstream           f(r.rule);
+                std::set<std::string>        subjects;
+                std::vector<PureAlert>       alerts;
+                AlertConfiguration::iterator it;
+                if (ac.addRule(f, subjects, alerts, it) == 0) {
+                    for (const auto& topic : it->second.first->getNeededTopics()) {
+                        topics.insert(topic);
+                    }
+                    rules++;
+                }
+            }
+        }
+
+        for (const auto& topic : topics) {
+            size_t at = topic.find('@');
+            if (at == std::string::npos || topic[0] == '^') {
+                continue;
+            }
+            metrics.emplace_back(topic.substr(at + 1), topic.substr(0, at), "", 0, 0, "", 300);
+        }
+    }
+
+    /// Built once per number of devices, setup is much longer than a cycle
+    static Engine& get(size_t devices)
+    {
+        static std::map<size_t, std::unique_ptr<Engine>> engines;
+
+        auto& engine = engines[devices];
+        if (!engine) {
+            engine.reset(new Engine(devices));
+        }
+        return *engine;
+    }
+};
+
+// One polling cycle as done by metric_processing() and evaluate_metric(), without sending alerts:
+// every metric is stored, then each rule using it is evaluated and its alert updated.
+static void BM_Cycle(benchmark::State& state)
+{
+    Engine&      engine = Engine::get(static_cast<size_t>(state.range(0)));
+    const size_t count  = static_cast<size_t>(state.range(1));
+    if (engine.metrics.empty()) {
+        state.SkipWithError("no rules generated, check templates");
+        return;
+    }
+
+    MetricList list;
+    size_t     step        = 0;
+    uint64_t   evaluations = 0;
+    uint64_t   alerts      = 0;
+    for (auto _ : state) {
+        uint64_t timestamp = bench::now();
+        list.setTime(timestamp);
+        for (size_t i = 0; i < count; i++, step++) {
+            // values walk through thresholds, so alerts are raised and resolved
+            const MetricInfo& known = engine.metrics[step % engine.metrics.size()];
+            MetricInfo        metric(known.getElementName(), known.getSource(), "", static_cast<double>(step % 97),
+                timestamp, "", 300);
+            list.addMetric(metric);
+
+            for (const auto& rulename : engine.ac.getRulesByMetric(metric.generateTopic())) {
+                auto&     rule = engine.ac.at(rulename);
+                PureAlert pureAlert;
+                evaluations++;
+                if (rule.first->evaluate(list, pureAlert) != 0) {
+                    continue;
+                }
+                PureAlert alertToSend;
+                if (engine.ac.updateAlert(rule, pureAlert, alertToSend) == 0) {
+                    alerts++;
+                }
+            }
+        }
+    }
+
+    state.counters["rules"]       = static_cast<double>(engine.rules);
+    state.counters["topics"]      = static_cast<double>(engine.metrics.size());
+    state.counters["evaluations"] =
+        benchmark::Counter(static_cast<double>(evaluations), benchmark::Counter::kAvgIterations);
+    state.counters["alerts"] = benchmark::Counter(static_cast<double>(alerts), benchmark::Counter::kAvgIterations);
+    state.SetItemsProcessed(state.iterations() * state.range(1));
+}
+BENCHMARK(BM_Cycle)
+    ->ArgNames({"devices", "metrics"})
+    ->Args({10, 1000})
+    ->Args({100, 1000})
+    ->Args({100, 10000})
+    ->Args({1000, 10000})
+    ->Unit(benchmark::kMillisecond);
+
+// Rendering of rules for devices due for configuration by Autoconfig::onPoll() with the given number of threads,
+// including parsing of the rules for the engine of the process (see RuleChannel).
+static void BM_Onboarding(benchmark::State& state)
+{
+    bench::useSourceTemplates();
+    Autoconfig::AlertEngineName = "fty-alert-engine-bench";
+    zsock_t* channel            = RuleChannel::bind(Autoconfig::AlertEngineName);
+    if (!channel) {
+        state.SkipWithError("rule channel is bound already");
+        return;
+    }
+
+    const size_t                                 count   = static_cast<size_t>(state.range(0));
+    const size_t                                 workers = static_cast<size_t>(state.range(1));
+    std::map<std::string, AutoConfigurationInfo> devices;
+    for (size_t i = 0; i < count; i++) {
+        std::string           name;
+        AutoConfigurationInfo info = bench::upsDevice(i, name);
+        devices.emplace(name, info);
+    }
+    TemplateRuleConfigurator configurator;
+
+    size_t rules = 0, parsed = 0;
+    for (auto _ : state) {
+        // nothing generated before, all rules are new
+        std::map<std::string, GeneratedRules> generated;
+        std::vector<DueDevice>                due;
+        for (auto it = devices.begin(); it != devices.end(); ++it) {
+            DueDevice device;
+            device.it         = it;
+            device.applicable = true;
+            device.ename_la   = "Datacenter 1";
+            device.generated  = &generated[it->first];
+            due.push_back(std::move(device));
+        }
+
+        configurator.render(due, workers);
+
+        rules = parsed = 0;
+        for (const auto& device : due) {
+            rules += device.rendered.size();
+            for (const auto& r : device.rendered) {
+                parsed += r.parsed ? 1 : 0;
+            }
+        }
+    }
+
+    RuleChannel::unbind(Autoconfig::AlertEngineName);
+    state.counters["rules"]  = static_cast<double>(rules);
+    state.counters["parsed"] = static_cast<double>(parsed);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Onboarding)
+    ->ArgNames({"devices", "threads"})
+    ->Args({10000, 1})
+    ->Args({10000, 4})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
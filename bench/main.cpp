@@ -0,0 +1,56 @@
+/*  =========================================================================
+    main - Runs benchmarks of the engine, reports JSON unless asked otherwise
+
+    Copyright (C) 2014 - 2021 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#include "src/fty_alert_engine_audit_log.h"
+#include <benchmark/benchmark.h>
+#include <cstring>
+#include <fty_log.h>
+#include <vector>
+
+int main(int argc, char** argv)
+{
+    ManageFtyLog::setInstanceFtylog("fty-alert-engine-bench");
+
+    // JSON is what CI compares between runs
+    std::vector<char*> args(argv, argv + argc);
+    bool               format = false;
+    for (int i = 1; i < argc; i++) {
+        format |= (strncmp(argv[i], "--benchmark_format", 18) == 0);
+    }
+    char json[] = "--benchmark_format=json";
+    if (!format) {
+        args.push_back(json);
+    }
+    int count = static_cast<int>(args.size());
+
+    // rules are evaluated as in the engine, audit records go to the writer thread
+    AuditLogManager::startAsync();
+
+    benchmark::Initialize(&count, args.data());
+    if (benchmark::ReportUnrecognizedArguments(count, args.data())) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    AuditLogManager::deinit();
+    return 0;
+}
@@ -0,0 +1,231 @@
+/*  =========================================================================
+    micro - Benchmarks of single operations of the engine
+
+    Copyright (C) 2014 - 2021 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#include "bench.h"
+#include "src/alertconfiguration.h"
+#include "src/metriclist.h"
+#include "src/templateruleconfigurator.h"
+#include <benchmark/benchmark.h>
+#include <sstream>
+
+// metric "<source>@<element>" of a device, sources cycle through a UPS-like set
+static MetricInfo s_metric(size_t i, double value, uint64_t timestamp)
+{
+    static const char* sources[] = {"status.ups", "load.default", "realpower.default", "voltage.input_L1-N",
+        "current.output_L1", "temperature.default", "charge.battery", "runtime.battery"};
+    const size_t       count     = sizeof(sources) / sizeof(sources[0]);
+
+    return MetricInfo("ups-" + std::to_string(i / count + 1), sources[i % count], "", value, timestamp, "", 300);
+}
+
+static RulePtr s_read_rule(const std::string& file)
+{
+    std::istringstream f(bench::readSource("test/testrules/" + file));
+    RulePtr            rule;
+    if (readRule(f, rule) != 0) {
+        return nullptr;
+    }
+    return rule;
+}
+
+// MetricList
+
+static void BM_MetricListAddMetric(benchmark::State& state)
+{
+    const size_t            count = static_cast<size_t>(state.range(0));
+    std::vector<MetricInfo> metrics;
+    for (size_t i = 0; i < count; i++) {
+        metrics.push_back(s_metric(i, 42, bench::now()));
+    }
+
+    MetricList list;
+    size_t     i = 0;
+    for (auto _ : state) {
+        list.addMetric(metrics[i]);
+        i = (i + 1) % count;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MetricListAddMetric)->Arg(1000)->Arg(100000);
+
+static void BM_MetricListFind(benchmark::State& state)
+{
+    const size_t             count = static_cast<size_t>(state.range(0));
+    std::vector<std::string> topics;
+    MetricList               list;
+    for (size_t i = 0; i < count; i++) {
+        MetricInfo metric = s_metric(i, 42, bench::now());
+        list.addMetric(metric);
+        topics.push_back(metric.generateTopic());
+    }
+
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(list.find(topics[i]));
+        i = (i + 1) % count;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MetricListFind)->Arg(1000)->Arg(100000);
+
+static void BM_MetricListRemoveOldMetrics(benchmark::State& state)
+{
+    // every other metric is expired
+    const size_t count = static_cast<size_t>(state.range(0));
+    for (auto _ : state) {
+        state.PauseTiming();
+        MetricList list;
+        for (size_t i = 0; i < count; i++) {
+            list.addMetric(s_metric(i, 42, (i % 2) ? bench::now() : 1));
+        }
+        state.ResumeTiming();
+
+        list.removeOldMetrics();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_MetricListRemoveOldMetrics)->Arg(1000)->Arg(100000);
+
+// readRule
+
+static void BM_ReadRule(benchmark::State& state, const char* file)
+{
+    const std::string json = bench::readSource(std::string("test/testrules/") + file);
+    for (auto _ : state) {
+        std::istringstream f(json);
+        RulePtr            rule;
+        if (readRule(f, rule) != 0) {
+            state.SkipWithError("rule not parsed");
+            break;
+        }
+        benchmark::DoNotOptimize(rule);
+    }
+}
+BENCHMARK_CAPTURE(BM_ReadRule, single, "single.rule");
+BENCHMARK_CAPTURE(BM_ReadRule, pattern, "pattern.rule");
+BENCHMARK_CAPTURE(BM_ReadRule, threshold_simple, "simplethreshold.rule");
+BENCHMARK_CAPTURE(BM_ReadRule, threshold_complex, "complexthreshold.rule");
+BENCHMARK_CAPTURE(BM_ReadRule, threshold_device, "devicethreshold.rule");
+
+// evaluate
+
+static void BM_LuaRuleEvaluate(benchmark::State& state)
+{
+    RulePtr rule = s_read_rule("single.rule");
+    if (!rule) {
+        state.SkipWithError("rule not parsed");
+        return;
+    }
+    MetricList list;
+    list.addMetric(MetricInfo("sss1", "abc", "", 5, bench::now(), "", 300));
+    list.addMetric(MetricInfo("sss2", "abc", "", 6, bench::now(), "", 300));
+
+    for (auto _ : state) {
+        PureAlert alert;
+        benchmark::DoNotOptimize(rule->evaluate(list, alert));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LuaRuleEvaluate);
+
+static void BM_ThresholdRuleSimpleEvaluate(benchmark::State& state)
+{
+    RulePtr rule = s_read_rule("simplethreshold.rule");
+    if (!rule) {
+        state.SkipWithError("rule not parsed");
+        return;
+    }
+    // value between warning thresholds, no alert
+    MetricList list;
+    list.addMetric(MetricInfo("fff", "abc", "", 45, bench::now(), "", 300));
+
+    for (auto _ : state) {
+        PureAlert alert;
+        benchmark::DoNotOptimize(rule->evaluate(list, alert));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ThresholdRuleSimpleEvaluate);
+
+// AlertConfiguration
+
+static void BM_AlertConfigurationUpdateAlert(benchmark::State& state)
+{
+    AlertConfiguration ac(bench::emptyDir("update-alert"));
+    RulePtr            rule = s_read_rule("simplethreshold.rule");
+    if (!rule) {
+        state.SkipWithError("rule not parsed");
+        return;
+    }
+    std::set<std::string>        subjects;
+    std::vector<PureAlert>       alerts;
+    AlertConfiguration::iterator it;
+    if (ac.addRule(std::move(rule), subjects, alerts, it) != 0) {
+        state.SkipWithError("rule not added");
+        return;
+    }
+
+    // alert flips between active and resolved, so every update changes it
+    PureAlert active(ALERT_START, bench::now(), "high", "fff", "CRITICAL", {"EMAIL"});
+    PureAlert resolved(ALERT_RESOLVED, bench::now(), "ok", "fff", "", {});
+    bool      flip = false;
+    for (auto _ : state) {
+        PureAlert toSend;
+        benchmark::DoNotOptimize(ac.updateAlert(it->second, flip ? active : resolved, toSend));
+        flip = !flip;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_AlertConfigurationUpdateAlert);
+
+// utf8eq
+
+static void BM_Utf8eq(benchmark::State& state, const char* s1, const char* s2)
+{
+    const std::string a(s1);
+    const std::string b(s2);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(utf8eq(a, b));
+    }
+}
+BENCHMARK_CAPTURE(BM_Utf8eq, ascii, "realpower.default@ups-1234", "RealPower.Default@UPS-1234");
+BENCHMARK_CAPTURE(BM_Utf8eq, ascii_differ, "realpower.default@ups-1234", "realpower.default@ups-1235");
+BENCHMARK_CAPTURE(BM_Utf8eq, utf8, "teplota@čidlo-ÚSTŘEDNA", "TEPLOTA@ČIDLO-ústředna");
+
+// template rendering
+
+static void BM_TemplateRender(benchmark::State& state)
+{
+    bench::useSourceTemplates();
+
+    TemplateRuleConfigurator configurator;
+    std::string              name;
+    AutoConfigurationInfo    info = bench::upsDevice(0, name);
+    GeneratedRules           generated;
+    RenderedRules            rendered;
+    for (auto _ : state) {
+        configurator.render(name, info, "Datacenter 1", generated, rendered);
+        benchmark::DoNotOptimize(rendered.data());
+    }
+    state.counters["rules"] = static_cast<double>(rendered.size());
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TemplateRender);
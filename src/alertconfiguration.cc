@@ -18,7 +18,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "alertconfiguration.h"
 #include "templateruleconfigurator.h"
 #include "autoconfig.h"
+#include "debuglog.h"
 #include "normalrule.h"
+#include "probes.h"
 #include "regexrule.h"
 #include "thresholdrulecomplex.h"
 #include "thresholdruledevice.h"
@@ -185,7 +187,7 @@ std::set<std::string> AlertConfiguration::readConfiguration(void)
 }
 
 int AlertConfiguration::addRule(std::istream& newRuleString, std::set<std::string>& newSubjectsToSubscribe,
-    std::vector<PureAlert>& /* alertsToSend */, AlertConfiguration::iterator&       it)
+    std::vector<PureAlert>& alertsToSend, AlertConfiguration::iterator& it)
 {
     // ASSUMPTIONS: newSubjectsToSubscribe and  alertsToSend are empty
     RulePtr temp_rule;
@@ -198,7 +200,13 @@ int AlertConfiguration::addRule(std::istream& newRuleString, std::set<std::strin
         log_error("nothing created, lua error");
         return -5;
     }
+    return addRule(std::move(temp_rule), newSubjectsToSubscribe, alertsToSend, it);
+}
 
+int AlertConfiguration::addRule(RulePtr temp_rule, std::set<std::string>& newSubjectsToSubscribe,
+    std::vector<PureAlert>& /* alertsToSend */, AlertConfiguration::iterator& it)
+{
+    // ASSUMPTIONS: newSubjectsToSubscribe and  alertsToSend are empty
     // PQSWMBT-3723, don't instanciate sensor temp./humidity rules directly
     if ((temp_rule->name().find("humidity.default@sensor-") == 0) // starts with...
         || (temp_rule->name().find("temperature.default@sensor-") == 0)) {
@@ -208,8 +216,10 @@ int AlertConfiguration::addRule(std::istream& newRuleString, std::set<std::strin
     // end PQSWMBT-3723
 
     // PQSWMBT-4921 Xphase rule exceptions (see templateruleconfigurator.cc)
+    // asset info is copied from autoconfig only for Xphase rules
     auto asset = temp_rule->name().substr(temp_rule->name().find("@") + 1);
-    if (!ruleXphaseIsApplicable(temp_rule->name(), getAssetInfoFromAutoconfig(asset))) {
+    if (isXphaseRule(temp_rule->name()) &&
+        !ruleXphaseIsApplicable(temp_rule->name(), getAssetInfoFromAutoconfig(asset))) {
         log_debug("Xphase rule instanciation rejected (%s)", temp_rule->name().c_str());
         return -101;
     }
@@ -483,13 +493,15 @@ int AlertConfiguration::updateAlert(std::pair<RulePtr, std::vector<PureAlert>>&
         if (pureAlert._status == ALERT_START) {
             if (oneAlert._status == ALERT_RESOLVED) {
                 // Found alert is old. This is new one
+                trace_probe4(alert_transition, oneRuleAlerts.first->name().c_str(), oneAlert._element.c_str(),
+                    oneAlert._status.c_str(), pureAlert._status.c_str());
                 oneAlert._status      = pureAlert._status;
                 oneAlert._timestamp   = pureAlert._timestamp;
                 oneAlert._description = pureAlert._description;
                 oneAlert._severity    = pureAlert._severity;
                 oneAlert._actions     = pureAlert._actions;
                 // element is the same -> no need to update the field
-                log_debug("RULE '%s' : OLD ALERT starts again for element '%s' with description '%s'",
+                log_debug_hot("RULE '%s' : OLD ALERT starts again for element '%s' with description '%s'",
                     oneRuleAlerts.first->name().c_str(), oneAlert._element.c_str(), oneAlert._description.c_str());
             } else {
                 // Found alert is still active -> it is the same alert
@@ -497,7 +509,7 @@ int AlertConfiguration::updateAlert(std::pair<RulePtr, std::vector<PureAlert>>&
                 oneAlert._description = pureAlert._description;
                 oneAlert._severity    = pureAlert._severity;
                 oneAlert._actions     = pureAlert._actions;
-                log_debug("RULE '%s' : ALERT is ALREADY ongoing for element '%s' with description '%s'",
+                log_debug_hot("RULE '%s' : ALERT is ALREADY ongoing for element '%s' with description '%s'",
                     oneRuleAlerts.first->name().c_str(), oneAlert._element.c_str(), oneAlert._description.c_str());
             }
             // in both cases we need to send an alert
@@ -508,12 +520,14 @@ int AlertConfiguration::updateAlert(std::pair<RulePtr, std::vector<PureAlert>>&
         if (pureAlert._status == ALERT_RESOLVED) {
             if (oneAlert._status != ALERT_RESOLVED) {
                 // Found alert is not resolved. -> resolve it
+                trace_probe4(alert_transition, oneRuleAlerts.first->name().c_str(), oneAlert._element.c_str(),
+                    oneAlert._status.c_str(), pureAlert._status.c_str());
                 oneAlert._status      = pureAlert._status;
                 oneAlert._timestamp   = pureAlert._timestamp;
                 oneAlert._description = pureAlert._description;
                 oneAlert._severity    = pureAlert._severity;
                 oneAlert._actions     = pureAlert._actions;
-                log_debug("RULE '%s' : ALERT is resolved for element '%s' with description '%s'",
+                log_debug_hot("RULE '%s' : ALERT is resolved for element '%s' with description '%s'",
                     oneRuleAlerts.first->name().c_str(), oneAlert._element.c_str(), oneAlert._description.c_str());
                 alert_to_send = oneAlert;
                 // alert_to_send = PureAlert(oneAlert);
@@ -531,8 +545,10 @@ int AlertConfiguration::updateAlert(std::pair<RulePtr, std::vector<PureAlert>>&
         // IPMVAL-2411 fix: enlarge to RESOLVED status (eg. any known status)
         //             was: if (pureAlert._status != ALERT_RESOLVED)
         if (PureAlert::isStatusKnown(pureAlert._status.c_str())) {
+            trace_probe4(alert_transition, oneRuleAlerts.first->name().c_str(), pureAlert._element.c_str(), "",
+                pureAlert._status.c_str());
             oneRuleAlerts.second.push_back(pureAlert);
-            log_debug("RULE '%s' : ALERT is NEW for element '%s' with description '%s'",
+            log_debug_hot("RULE '%s' : ALERT is NEW for element '%s' with description '%s'",
                 oneRuleAlerts.first->name().c_str(), pureAlert._element.c_str(), pureAlert._description.c_str());
             alert_to_send = PureAlert(pureAlert);
             return 0;
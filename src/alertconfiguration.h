@@ -126,6 +126,15 @@ public:
     int addRule(std::istream& newRuleString, std::set<std::string>& newSubjectsToSubscribe,
         std::vector<PureAlert>& alertsToSend, iterator& it);
 
+    /// Adds an already parsed rule to the configuration
+    ///
+    /// Same as addRule(std::istream&, ...) without the parsing, used for rules parsed by the producer
+    /// (see RuleChannel).
+    ///
+    /// @return same as addRule(std::istream&, ...), except -1 and -5
+    int addRule(RulePtr rule, std::set<std::string>& newSubjectsToSubscribe, std::vector<PureAlert>& alertsToSend,
+        iterator& it);
+
     /// Updates existing rule in the configuration
     ///
     /// alertsToSend must be sent in the order from the first element to the last element
@@ -20,17 +20,24 @@
 */
 
 #include "autoconfig.h"
+#include "ruletemplatecache.h"
 #include "templateruleconfigurator.h"
+#include <algorithm>
 #include <cxxtools/jsondeserializer.h>
-#include <cxxtools/jsonserializer.h>
 #include <fstream>
 #include <fty_common_filesystem.h>
 #include <fty_log.h>
 #include <iostream>
 #include <lua.h>
+#include <vector>
 
 #define AUTOCONFIG "AUTOCONFIG"
 
+// delay of the first configuration attempt, lets bursts of asset messages settle
+#define AUTOCONFIG_FIRST_ATTEMPT_DELAY 5000
+// delay of the next attempt when configuration failed
+#define AUTOCONFIG_RETRY_DELAY 60000
+
 std::string Autoconfig::StateFilePath;
 std::string Autoconfig::RuleFilePath;
 std::string Autoconfig::StateFile;
@@ -56,35 +63,6 @@ static int load_agent_info(std::string& info)
     return -1;
 }
 
-static int save_agent_info(const std::string& json)
-{
-    if (!shared::is_dir(Autoconfig::StateFilePath.c_str())) {
-        log_error("Can't serialize state, '%s' is not directory", Autoconfig::StateFilePath.c_str());
-        return -1;
-    }
-    try {
-        std::ofstream f(Autoconfig::StateFile);
-        f.exceptions(~std::ofstream::goodbit);
-        f << json;
-        f.close();
-    } catch (const std::exception& e) {
-        log_error("Can't serialize state, %s", e.what());
-        return -1;
-    }
-    return 0;
-}
-
-inline void operator<<=(cxxtools::SerializationInfo& si, const AutoConfigurationInfo& info)
-{
-    si.setTypeName("AutoConfigurationInfo");
-    si.addMember("type") <<= info.type;
-    si.addMember("subtype") <<= info.subtype;
-    si.addMember("operation") <<= info.operation;
-    si.addMember("configured") <<= info.configured;
-    si.addMember("date") <<= std::to_string(info.date);
-    si.addMember("attributes") <<= info.attributes;
-}
-
 inline void operator>>=(const cxxtools::SerializationInfo& si, AutoConfigurationInfo& info)
 {
     std::string temp;
@@ -114,6 +92,7 @@ void Autoconfig::main (zsock_t* pipe, char* name)
     zsock_signal(pipe, 0);
 
     while (!zsys_interrupted) {
+        setPollingInterval();
         void* which = zpoller_wait(poller, _timeout);
         if (which == NULL) {
             if (zpoller_terminated(poller) || zsys_interrupted) {
@@ -122,20 +101,18 @@ void Autoconfig::main (zsock_t* pipe, char* name)
             }
             if (zpoller_expired(poller)) {
                 onPoll();
-                _timestamp = zclock_mono();
                 continue;
             }
-            _timestamp = zclock_mono();
             log_warning(
                 "zpoller_wait () returned NULL while at the same time zpoller_terminated == 0, zsys_interrupted == 0, "
                 "zpoller_expired == 0");
             continue;
         }
 
+        // configure due devices even when messages keep the poller busy
         int64_t now = zclock_mono();
-        if (now - _timestamp >= _timeout) {
+        if (_timeout >= 0 && now - _timestamp >= _timeout) {
             onPoll();
-            _timestamp = zclock_mono();
         }
 
         if (which == pipe) {
@@ -162,6 +139,7 @@ void Autoconfig::main (zsock_t* pipe, char* name)
                 if (dirname) {
                     Autoconfig::StateFilePath = std::string(dirname);
                     Autoconfig::StateFile     = Autoconfig::StateFilePath + "/state";
+                    _state.setPath(Autoconfig::StateFile);
                 } else {
                     log_error("%s: in CONFIG command next frame is missing", name);
                 }
@@ -274,24 +252,76 @@ const std::string Autoconfig::getEname(const std::string& iname)
     return ename;
 }
 
+// FNV-1a of a string, terminated so that consecutive strings can't be shifted
+static uint64_t s_fnv1a(uint64_t hash, const char* str)
+{
+    for (const char* c = str ? str : ""; *c; c++) {
+        hash ^= static_cast<uint8_t>(*c);
+        hash *= 0x100000001b3ULL;
+    }
+    hash ^= 0xff;
+    hash *= 0x100000001b3ULL;
+    return hash;
+}
+
+// computed without any allocation, ext attributes are combined regardless of their order
+uint64_t assetFingerprint(fty_proto_t* message)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    hash          = s_fnv1a(hash, fty_proto_operation(message));
+    hash          = s_fnv1a(hash, fty_proto_aux_string(message, "type", ""));
+    hash          = s_fnv1a(hash, fty_proto_aux_string(message, "subtype", ""));
+    hash          = s_fnv1a(hash, fty_proto_aux_string(message, FTY_PROTO_ASSET_STATUS, "active"));
+
+    uint64_t ext   = 0;
+    uint64_t count = 0;
+    zhash_t* attrs = fty_proto_ext(message);
+    if (attrs) {
+        for (void* value = zhash_first(attrs); value; value = zhash_next(attrs)) {
+            // splitmix64 finalizer, so that the sum doesn't cancel out similar attributes
+            uint64_t attr = s_fnv1a(s_fnv1a(0xcbf29ce484222325ULL, zhash_cursor(attrs)), static_cast<char*>(value));
+            attr          = (attr ^ (attr >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            attr          = (attr ^ (attr >> 27)) * 0x94d049bb133111ebULL;
+            ext += attr ^ (attr >> 31);
+            count++;
+        }
+    }
+    return (hash ^ ext) * 0x100000001b3ULL + count;
+}
+
 void Autoconfig::onSend(fty_proto_t** message)
 {
     if (!message || !*message)
         return;
 
     std::string device_name (fty_proto_name (*message));
-    auto currentInfo = configurableDevicesGet(device_name);
+    uint64_t    fingerprint = assetFingerprint(*message);
 
     //filter UPDATE message to ignore it when no change is detected.
     //This code is mainly to prevent overload activity on hourly REPUBLISH $all
+    if (strcmp(fty_proto_operation (*message), FTY_PROTO_ASSET_OP_UPDATE) == 0) {
+        auto it = _fingerprints.find(device_name);
+        if (it != _fingerprints.end() && it->second == fingerprint) {
+            log_debug("asset %s UPDATED but no change detected => ignore it",device_name.c_str());
+            return;
+        }
+    }
+
+    auto currentInfo = configurableDevicesGet(device_name);
+
+    // devices restored by loadState have no fingerprint yet
     if ((strcmp(fty_proto_operation (*message), FTY_PROTO_ASSET_OP_UPDATE) == 0)
         && !currentInfo.empty()
         && (currentInfo == *message))
     {
         log_debug("asset %s UPDATED but no change detected => ignore it",device_name.c_str());
+        _fingerprints[device_name] = fingerprint;
         return;
     }
 
+    // phases of the asset may have changed
+    ruleXphaseInvalidate(device_name);
+
     AutoConfigurationInfo info;
     info.type.assign (fty_proto_aux_string (*message, "type", ""));
     info.subtype.assign (fty_proto_aux_string (*message, "subtype", ""));
@@ -343,10 +373,17 @@ void Autoconfig::onSend(fty_proto_t** message)
         && streq (fty_proto_aux_string (*message, FTY_PROTO_ASSET_STATUS, "active"), "active"))
     {
         configurableDevicesAdd(device_name, info);
+        _fingerprints[device_name] = fingerprint;
+        _state.put(device_name, info);
+        schedulePending(device_name, static_cast<uint64_t>(zclock_mono()) + AUTOCONFIG_FIRST_ATTEMPT_DELAY);
     }
     else
     {
         configurableDevicesRemove(device_name);
+        _fingerprints.erase(device_name);
+        _state.remove(device_name);
+        _pending.erase(device_name);
+        _generatedRules.erase(device_name);
 
         if (info.subtype == "sensorgpio" || info.subtype == "gpo") {
             // don't do anything
@@ -364,96 +401,153 @@ void Autoconfig::onSend(fty_proto_t** message)
             }
         }
     }
-    saveState();
-    setPollingInterval();
+    compactState();
 }
 
 void Autoconfig::onPoll()
 {
     static TemplateRuleConfigurator iTemplateRuleConfigurator;
 
-    bool save = false;
+    bool     save = false;
+    uint64_t now  = static_cast<uint64_t>(zclock_mono());
+
+    std::vector<DueDevice> due;
+    while (!_pendingQueue.empty() && _pendingQueue.top().first <= now) {
+        std::string name     = _pendingQueue.top().second;
+        uint64_t    deadline = _pendingQueue.top().first;
+        _pendingQueue.pop();
+        auto pending = _pending.find(name);
+        if (pending == _pending.end() || pending->second != deadline)
+            continue; // removed or rescheduled meanwhile
+        _pending.erase(pending);
+
+        // _configurableDevices is modified only by this thread, other threads just read it under the lock,
+        // so the device is read without the lock and configure (sending rules) doesn't block them
+        auto it = _configurableDevices.find(name);
+        if (it == _configurableDevices.end() || it->second.configured)
+            continue;
 
-    {
-        ConfigurableDevices_GUARD;
-        //std::map<std::string, AutoConfigurationInfo>
-        for (auto& it : _configurableDevices) {
-            if (zsys_interrupted)
-                return;
-            if (it.second.configured)
-                continue;
+        DueDevice device;
+        device.it = it;
+        // device without templates still has to delete rules generated before
+        if (iTemplateRuleConfigurator.isApplicable (it->second) || _generatedRules.count(name) != 0)
+        {
+            device.applicable = true;
+            device.ename_la   = Autoconfig::getEname (it->second.getAttr("logical_asset"));
+            device.generated  = &_generatedRules[name];
+        }
+        else {
+            log_info ("No applicable configurator for device '%s', not configuring", it->first.c_str ());
+        }
+        due.push_back(std::move(device));
+    }
 
-            bool device_configured = true;
-            if (iTemplateRuleConfigurator.isApplicable (it.second))
-            {
-                std::string la;
-                for (auto &i : it.second.attributes)
-                {
-                    if (i.first == "logical_asset")
-                        la = i.second;
-                }
+    // rules are generated (and parsed) in parallel, sent from this thread in order
+    iTemplateRuleConfigurator.render(due);
 
-                device_configured &= iTemplateRuleConfigurator.configure (
-                    it.first, it.second,
-                    Autoconfig::getEname (la), client ()
-                );
-            }
-            else {
-                log_info ("No applicable configurator for device '%s', not configuring", it.first.c_str ());
-            }
+    for (auto& device : due) {
+        if (zsys_interrupted)
+            return;
 
-            if (device_configured) {
-                log_debug ("Device '%s' configured successfully", it.first.c_str ());
-                it.second.configured = true;
-                save = true;
-            }
-            else {
-                log_debug ("Device '%s' NOT configured yet.", it.first.c_str ());
-            }
+        auto it                = device.it;
+        bool device_configured = true;
+        if (device.rendered_ok) {
+            device_configured &=
+                iTemplateRuleConfigurator.apply(it->first, device.rendered, client(), *device.generated);
+            _state.putRules(it->first, *device.generated);
+            save = true;
+        }
+
+        {
+            ConfigurableDevices_GUARD;
+            if (device_configured)
+                it->second.configured = true;
+            it->second.date = now;
+        }
 
-            it.second.date = static_cast<uint64_t>(zclock_mono ());
+        if (device_configured) {
+            log_debug ("Device '%s' configured successfully", it->first.c_str ());
+            _state.put(it->first, it->second);
+            save = true;
+        }
+        else {
+            log_debug ("Device '%s' NOT configured yet.", it->first.c_str ());
+            schedulePending(it->first, now + AUTOCONFIG_RETRY_DELAY);
         }
     }
 
     if (save) {
-        cleanupState();
-        saveState();
+        compactState();
     }
-    setPollingInterval();
 }
 
 // autoconfig agent private methods
 
-void Autoconfig::setPollingInterval()
+void Autoconfig::schedulePending(const std::string& name, uint64_t deadline)
 {
-    _timeout = -1;
+    _pending[name] = deadline;
+    _pendingQueue.emplace(deadline, name);
+}
 
+void Autoconfig::schedulePendingDevices()
+{
+    _pending.clear();
+    _pendingQueue = decltype(_pendingQueue)();
+
+    uint64_t now = static_cast<uint64_t>(zclock_mono());
     ConfigurableDevices_GUARD;
-    for ( auto &it : _configurableDevices) {
-        if ( ! it.second.configured ) {
-            if ( it.second.date == 0 ) {
-                // there is device that we didn't try to configure
-                // let's try to do it soon
-                _timeout = 5000;
-                return;
-            } else {
-                // we failed to configure some device
-                // let's try after one minute again
-                _timeout = 60000;
-            }
+    for (const auto& it : _configurableDevices) {
+        if (!it.second.configured) {
+            // device that we didn't try to configure yet is tried soon, failed one after a while
+            schedulePending(
+                it.first, now + ((it.second.date == 0) ? AUTOCONFIG_FIRST_ATTEMPT_DELAY : AUTOCONFIG_RETRY_DELAY));
         }
     }
 }
 
+void Autoconfig::setPollingInterval()
+{
+    // drop stale entries, so that the top is the next attempt
+    while (!_pendingQueue.empty()) {
+        auto pending = _pending.find(_pendingQueue.top().second);
+        if (pending != _pending.end() && pending->second == _pendingQueue.top().first)
+            break;
+        _pendingQueue.pop();
+    }
+
+    _timestamp = zclock_mono();
+    if (_pendingQueue.empty()) {
+        _timeout = -1;
+        return;
+    }
+    uint64_t next = _pendingQueue.top().first;
+    uint64_t now  = static_cast<uint64_t>(_timestamp);
+    _timeout      = (next > now) ? static_cast<int>(next - now) : 0;
+}
+
 void Autoconfig::loadState()
 {
+    ConfigurableDevices_GUARD;
+    _state.setPath(StateFile);
+    _fingerprints.clear();
+    if (_state.load(_configurableDevices, _generatedRules) == -2)
+        loadLegacyState();
+
+    _devicesByType.clear();
+    for (const auto& it : _configurableDevices)
+        indexDevice(it.first, it.second, true);
+}
+
+// state saved by previous versions, in JSON
+void Autoconfig::loadLegacyState()
+{
+    ConfigurableDevices_GUARD;
     std::string json = "";
     int         rv   = load_agent_info(json);
     if (rv != 0 || json.empty())
         return;
 
     try {
-        ConfigurableDevices_GUARD;
         std::istringstream in(json);
         _configurableDevices.clear();
         cxxtools::JsonDeserializer deserializer(in);
@@ -461,44 +555,51 @@ void Autoconfig::loadState()
     }
     catch (const std::exception &e) {
         log_error( "can't parse state: %s", e.what() );
+        return;
     }
+    log_info("State '%s' converted to binary format", StateFile.c_str());
+    saveState();
 }
 
-void Autoconfig::cleanupState()
+void Autoconfig::saveState()
 {
-    log_debug("State file size before cleanup '%zu'", _configurableDevices.size());
-
-    // Just set the state file to empty
-    save_agent_info("");
-    return;
+    ConfigurableDevices_GUARD;
+    _state.setPath(StateFile);
+    log_debug("%s: State file size = '%zu'", __FUNCTION__, _configurableDevices.size());
+    _state.compact(_configurableDevices, _generatedRules);
 }
 
-void Autoconfig::saveState()
+void Autoconfig::compactState()
 {
     ConfigurableDevices_GUARD;
-    std::ostringstream stream;
-
-    cxxtools::JsonSerializer serializer(stream);
-    log_debug("%s: State file size = '%zu'", __FUNCTION__, _configurableDevices.size());
-    serializer.serialize(_configurableDevices);
-    serializer.finish();
-    std::string json = stream.str();
-    save_agent_info(json);
+    if (_state.needsCompaction(_configurableDevices.size()))
+        saveState();
 }
 
 std::list<std::string> Autoconfig::getElemenListMatchTemplate(std::string template_name)
 {
-    TemplateRuleConfigurator templateRuleConfigurator;
-    std::list<std::string>   elementList;
-
-    ConfigurableDevices_GUARD;
-    for (auto& it : _configurableDevices) {
-        AutoConfigurationInfo info = it.second;
-        if (templateRuleConfigurator.isApplicable(info, template_name)) {
-            elementList.push_back(it.first);
+    // same as TemplateRuleConfigurator::isApplicable(info, template_name) for every device,
+    // but visits only the types (and models) whose devices it applies to
+    auto                templates = RuleTemplateCache::get();
+    const RuleTemplate* templat   = templates->find(template_name);
+    if (!templat)
+        return {}; // bad file
+
+    std::vector<std::string> elements;
+    {
+        ConfigurableDevices_GUARD;
+        for (const auto& type : _devicesByType) {
+            if (template_name.find(type.first) == std::string::npos)
+                continue; // no match
+            for (const auto& devices : type.second) {
+                if (!devices.first.empty() && templat->text().find(devices.first) == std::string::npos)
+                    continue; // model not found
+                elements.insert(elements.end(), devices.second.begin(), devices.second.end());
+            }
         }
     }
-    return elementList;
+    std::sort(elements.begin(), elements.end());
+    return std::list<std::string>(elements.begin(), elements.end());
 }
 
 void Autoconfig::listTemplates(const char* correlation_id, const char* filter)
@@ -511,29 +612,31 @@ void Autoconfig::listTemplates(const char* correlation_id, const char* filter)
     zmsg_addstr(reply, "LIST");
     zmsg_addstr(reply, myfilter);
 
-    TemplateRuleConfigurator                         templateRuleConfigurator;
-    std::vector<std::pair<std::string, std::string>> templates = templateRuleConfigurator.loadAllTemplates();
-    log_debug("number of total templates rules = '%zu'", templates.size());
+    auto templates = RuleTemplateCache::get();
+    if (!templates->exists()) {
+        log_info("TemplateRuleConfigurator '%s' dir does not exist", Autoconfig::RuleFilePath.c_str());
+    }
+    log_debug("number of total templates rules = '%zu'", templates->all().size());
     int count = 0;
-    for (const auto& templat : templates) {
+    for (const auto& templat : templates->all()) {
         //ZZZ assume myfilter (CAT_XXX) is only referenced in "rule_cat" array in rule
-        if (!streq(myfilter, "all") && (templat.second.find(myfilter) == std::string::npos)) {
-            log_trace("templates '%s' does not match", templat.first.c_str());
+        if (!streq(myfilter, "all") && (templat.text().find(myfilter) == std::string::npos)) {
+            log_trace("templates '%s' does not match", templat.name().c_str());
             continue;
         }
 
-        zmsg_addstr (reply, templat.first.c_str()); //rule name
-        zmsg_addstr (reply, templat.second.c_str()); //json payload
+        zmsg_addstr (reply, templat.name().c_str()); //rule name
+        zmsg_addstr (reply, templat.text().c_str()); //json payload
 
         //get list of element which can apply this template
-        std::list<std::string> elements=getElemenListMatchTemplate(templat.first.c_str());
+        std::list<std::string> elements=getElemenListMatchTemplate(templat.name());
         std::string element_list_output; //comma separator device list
-        auto templatAtPos = templat.first.find("@");
+        auto templatAtPos = templat.name().find("@");
         for (const auto &element : elements) {
             // PQSWMBT-4921 Xphase rule exceptions
             if (templatAtPos != std::string::npos) {
-                std::string ruleName{templat.first.substr(0, templatAtPos + 1) + element};
-                if (!ruleXphaseIsApplicable(ruleName, configurableDevicesGet(element)))
+                std::string ruleName{templat.name().substr(0, templatAtPos + 1) + element};
+                if (isXphaseRule(ruleName) && !ruleXphaseIsApplicable(ruleName, configurableDevicesGet(element)))
                     continue; // skip element
             }
             // end PQSWMBT-4921
@@ -545,7 +648,7 @@ void Autoconfig::listTemplates(const char* correlation_id, const char* filter)
 
         zmsg_addstr (reply, element_list_output.c_str());
         log_debug ("template: '%s', devices:'%s' match",
-                templat.first.c_str(),element_list_output.c_str());
+                templat.name().c_str(),element_list_output.c_str());
 
         count++;
     }
@@ -564,16 +667,47 @@ AutoConfigurationInfo Autoconfig::configurableDevicesGet(const std::string& asse
     return AutoConfigurationInfo(); // empty
 }
 
+void Autoconfig::indexDevice(const std::string& assetName, const AutoConfigurationInfo& info, bool add)
+{
+    std::string type_name =
+        TemplateRuleConfigurator::convertTypeSubType2Name(info.type.c_str(), info.subtype.c_str());
+    std::string model = (info.subtype == "sensorgpio") ? info.getAttr("model") : "";
+
+    ConfigurableDevices_GUARD;
+    if (add) {
+        _devicesByType[type_name][model].insert(assetName);
+        return;
+    }
+    auto type = _devicesByType.find(type_name);
+    if (type == _devicesByType.end())
+        return;
+    auto devices = type->second.find(model);
+    if (devices != type->second.end()) {
+        devices->second.erase(assetName);
+        if (devices->second.empty())
+            type->second.erase(devices);
+    }
+    if (type->second.empty())
+        _devicesByType.erase(type);
+}
+
 void Autoconfig::configurableDevicesAdd(const std::string& assetName, const AutoConfigurationInfo& info)
 {
     ConfigurableDevices_GUARD;
+    auto it = _configurableDevices.find(assetName);
+    if (it != _configurableDevices.end())
+        indexDevice(assetName, it->second, false);
     _configurableDevices[assetName] = info;
+    indexDevice(assetName, info, true);
 }
 
 bool Autoconfig::configurableDevicesRemove(const std::string& assetName)
 {
     ConfigurableDevices_GUARD;
     try {
+        auto it = _configurableDevices.find(assetName);
+        if (it != _configurableDevices.end())
+            indexDevice(assetName, it->second, false);
         _configurableDevices.erase(assetName);
         return true; // success
     }
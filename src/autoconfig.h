@@ -21,6 +21,7 @@
 
 #pragma once
 
+#include "statejournal.h"
 #include "utils.h"
 #include <fty_log.h>
 #include <fty_proto.h>
@@ -28,7 +29,10 @@
 #include <malamute.h>
 #include <map>
 #include <string>
+#include <unordered_map>
 #include <mutex>
+#include <queue>
+#include <set>
 
 #define RULES_SUBJECT "rfc-evaluator-rules"
 
@@ -98,8 +102,20 @@ struct AutoConfigurationInfo
     };
 };
 
+/// Rule sent for a device, kept to send only what changed when the device is configured again
+struct GeneratedRule
+{
+    uint64_t    hash = 0; // hash of the rule content
+    std::string name;     // rule name, empty when it couldn't be read
+    std::string dest;     // mailbox of the rule owner (fty-alert-engine, fty-alert-flexible)
+};
+typedef std::map<std::string, GeneratedRule> GeneratedRules; // template name | generated rule
+
 AutoConfigurationInfo getAssetInfoFromAutoconfig(const std::string& assetName);
 
+/// Fingerprint of the asset message fields compared by AutoConfigurationInfo::operator==, ext attributes in any order
+uint64_t assetFingerprint(fty_proto_t* message);
+
 void autoconfig(zsock_t* pipe, void* args);
 void autoconfig_test(bool verbose);
 
@@ -241,11 +257,11 @@ public:
     void onStart()
     {
         loadState();
+        schedulePendingDevices();
         setPollingInterval();
     };
     void onEnd()
     {
-        cleanupState();
         saveState();
     };
     void         onSend(fty_proto_t** message);
@@ -298,12 +314,30 @@ private:
     bool configurableDevicesRemove(const std::string& assetName);
     std::map<std::string, AutoConfigurationInfo> _configurableDevices;
     std::recursive_mutex _configurableDevicesMutex; // multi-thread access protection
+    std::unordered_map<std::string, uint64_t> _fingerprints; // iname | fingerprint of the last applied asset message
+    StateJournal _state; // persistence of _configurableDevices and _generatedRules
+    StateJournal::Rules _generatedRules; // iname | rules sent for the device
+
+    // _configurableDevices by template type name and model, guarded by _configurableDevicesMutex
+    // model is the one of sensorgpio devices (templates must mention it), empty for other devices
+    typedef std::map<std::string, std::set<std::string>> DevicesByModel; // model | inames
+    std::map<std::string, DevicesByModel> _devicesByType;                // type name | devices
+    void indexDevice(const std::string& assetName, const AutoConfigurationInfo& info, bool add);
+
+    // devices waiting for configuration, onPoll visits only those which are due
+    typedef std::pair<uint64_t, std::string> PendingEntry; // deadline | iname
+    std::unordered_map<std::string, uint64_t> _pending; // iname | deadline of the next attempt
+    std::priority_queue<PendingEntry, std::vector<PendingEntry>, std::greater<PendingEntry>>
+        _pendingQueue; // earliest deadline first, entries not matching _pending are stale
 
     void                                         handleReplies(zmsg_t* message);
+    void                                         schedulePending(const std::string& name, uint64_t deadline);
+    void                                         schedulePendingDevices();
     void                                         setPollingInterval();
-    void                                         cleanupState();
     void                                         saveState();
+    void                                         compactState();
     void                                         loadState();
+    void                                         loadLegacyState();
 
     // list of containers with their friendly names
     std::map<std::string, std::string> _containers; // iname | ename
@@ -0,0 +1,54 @@
+/*  =========================================================================
+    clock - Time source of the engine, real or simulated
+
+    Copyright (C) 2014 - 2021 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#include "clock.h"
+#include <czmq.h>
+#include <ctime>
+
+std::atomic<int64_t> Clock::_simulated{-1};
+
+uint64_t Clock::time()
+{
+    int64_t simulated = _simulated.load(std::memory_order_relaxed);
+    return (simulated >= 0) ? static_cast<uint64_t>(simulated / 1000) : static_cast<uint64_t>(::time(NULL));
+}
+
+int64_t Clock::timeMs()
+{
+    int64_t simulated = _simulated.load(std::memory_order_relaxed);
+    return (simulated >= 0) ? simulated : zclock_time();
+}
+
+int64_t Clock::mono()
+{
+    int64_t simulated = _simulated.load(std::memory_order_relaxed);
+    return (simulated >= 0) ? simulated : zclock_mono();
+}
+
+void Clock::simulate(int64_t ms)
+{
+    _simulated.store(ms < 0 ? 0 : ms, std::memory_order_relaxed);
+}
+
+void Clock::real()
+{
+    _simulated.store(-1, std::memory_order_relaxed);
+}
@@ -0,0 +1,84 @@
+/*  =========================================================================
+    clock - Time source of the engine, real or simulated
+
+    Copyright (C) 2014 - 2021 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/// Time of the engine, the system clock unless simulated
+///
+/// Replay of recorded metrics sets the simulated time to the time of every record, so that
+/// metric expiration and alert times are the same as when the metrics were recorded.
+/// Processing loops read the clock once per cycle or batch and pass the time down.
+class Clock
+{
+public:
+    /// Wall clock time, s (as time(NULL))
+    static uint64_t time();
+
+    /// Wall clock time, ms (as zclock_time())
+    static int64_t timeMs();
+
+    /// Monotonic time, ms (as zclock_mono()), the simulated wall clock time when simulated
+    static int64_t mono();
+
+    /// Switches to simulated time
+    /// @param[in] ms - wall clock time returned until the next call or real()
+    static void simulate(int64_t ms);
+
+    /// Switches back to the system clock
+    static void real();
+
+    /// Time is simulated
+    static bool simulated()
+    {
+        return _simulated.load(std::memory_order_relaxed) >= 0;
+    }
+
+private:
+    static std::atomic<int64_t> _simulated; // ms, -1 when the system clock is used
+};
+
+/// Simulated clock for the lifetime of the object, for tests
+class FakeClock
+{
+public:
+    /// @param[in] ms - initial wall clock time
+    explicit FakeClock(int64_t ms)
+    {
+        Clock::simulate(ms);
+    }
+
+    ~FakeClock()
+    {
+        Clock::real();
+    }
+
+    FakeClock(const FakeClock&) = delete;
+    FakeClock& operator=(const FakeClock&) = delete;
+
+    /// Moves the time forward
+    void advance(int64_t ms)
+    {
+        Clock::simulate(Clock::timeMs() + ms);
+    }
+};
@@ -0,0 +1,42 @@
+/*  =========================================================================
+    debuglog - Debug logging of hot paths
+
+    Copyright (C) 2014 - 2021 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+
+#include <fty_log.h>
+
+/// Debug level is enabled, false when built with FTY_ALERT_ENGINE_NO_DEBUG_LOG
+#ifdef FTY_ALERT_ENGINE_NO_DEBUG_LOG
+#define log_debug_enabled() false
+#else
+#define log_debug_enabled() __builtin_expect(ManageFtyLog::getInstanceFtylog()->isLogDebug(), 0)
+#endif
+
+/// log_debug for code run per metric or per rule evaluation
+///
+/// Arguments are evaluated only when debug level is enabled, the call is compiled out
+/// when built with FTY_ALERT_ENGINE_NO_DEBUG_LOG.
+#define log_debug_hot(...)                                                                                             \
+    do {                                                                                                               \
+        if (log_debug_enabled()) {                                                                                     \
+            log_debug(__VA_ARGS__);                                                                                    \
+        }                                                                                                              \
+    } while (0)
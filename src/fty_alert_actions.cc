@@ -20,8 +20,13 @@
 */
 
 #include "fty_alert_actions.h"
+#include "clock.h"
+#include "notificationoutbox.h"
 #include <fty_log.h>
 #include <fty_proto.h>
+#include <algorithm>
+#include <queue>
+#include <vector>
 
 #define TEST_ASSETS "ASSETS-TEST"
 #define TEST_ALERTS "ALERTS-TEST"
@@ -43,6 +48,12 @@
 #define FTY_ASSET_AGENT_ADDRESS       "asset-agent"
 #define FTY_SENSOR_GPIO_AGENT_ADDRESS "fty-sensor-gpio"
 
+#define OUTBOX_REPLY_TIMEOUT   30000 // ms to wait for fty-email/fty-sensor-gpio answer, request is not sent again
+#define OUTBOX_COALESCE_WINDOW 1000  // ms a notification waits for newer one with the same key
+#define OUTBOX_RETRY_BACKOFF   5000  // ms before first retry, doubled with every attempt
+#define OUTBOX_MAX_ATTEMPTS    3     // attempts to send a request which mlm_client_sendto() failed to send
+#define OUTBOX_MAX_IN_FLIGHT   32
+
 //  Some stuff for testing purposes
 //  to access test variables other than testing, use corresponding macro
 #if !defined(MLM_MAKE_VERSION) || !defined(MLM_VERSION)
@@ -85,7 +96,6 @@ static const std::map<std::pair<std::string, uint8_t>, uint32_t> times = {
 {
     mlm_client_t* client;
     mlm_client_t* requestreply_client;
-    zpoller_t*    requestreply_poller;
     zhash_t*      alerts_cache;
     zhash_t*      assets_cache;
     char*         name;
@@ -95,18 +105,27 @@ static const std::map<std::pair<std::string, uint8_t>, uint32_t> times = {
     uint64_t      requestreply_timeout;
 }; */
 
+//  Alert deadlines, earliest on top. Entries are not removed when alert changes
+//  or goes away, stale ones are recognized by s_alert_cache::scheduled mismatch
+typedef std::pair<uint64_t, std::string> s_alert_timer;
+struct s_alert_timers : public std::priority_queue<s_alert_timer, std::vector<s_alert_timer>, std::greater<s_alert_timer>>
+{
+};
+
 // Forward declaration for function sanity
 static void s_handle_stream_deliver_alert(fty_alert_actions_t*, fty_proto_t**, const char*);
 static void s_handle_stream_deliver_asset(fty_alert_actions_t*, fty_proto_t**, const char*);
 
 
 //  --------------------------------------------------------------------------
-//  Fty proto destroy wrapper for freefn
-void fty_proto_destroy_wrapper(void* x)
+//  Send request through requestreply client, message is consumed
+
+static int s_requestreply_send(fty_alert_actions_t* self, const char* address, const char* subject, zmsg_t** msg_p)
 {
-    fty_proto_destroy(reinterpret_cast<fty_proto_t**>(&x));
+    return mlm_client_sendto(self->requestreply_client, address, subject, NULL, 5000, msg_p);
 }
 
+
 //  --------------------------------------------------------------------------
 //  Create a new fty_alert_actions_t
 
@@ -119,12 +138,19 @@ fty_alert_actions_t* fty_alert_actions_new(void)
     assert(self->client);
     self->requestreply_client = mlm_client_new();
     assert(self->requestreply_client);
-    self->requestreply_poller = zpoller_new(mlm_client_msgpipe(self->requestreply_client), NULL);
-    assert(self->requestreply_poller);
-    self->alerts_cache = zhash_new();
-    assert(self->alerts_cache);
-    self->assets_cache = zhash_new();
-    assert(self->assets_cache);
+    self->requestreply_send = s_requestreply_send;
+    self->alerts_cache   = new s_alerts_cache();
+    self->assets_cache   = new s_assets_cache();
+    self->pending_assets = zhash_new();
+    assert(self->pending_assets);
+    self->pending_requests = zhash_new();
+    assert(self->pending_requests);
+    self->timers = new s_alert_timers();
+    self->outbox = new NotificationOutbox(
+        [self](const std::string& address, const std::string& subject, zmsg_t** msg_p) {
+            return self->requestreply_send(self, address.c_str(), subject.c_str(), msg_p);
+        },
+        OUTBOX_REPLY_TIMEOUT, OUTBOX_COALESCE_WINDOW, OUTBOX_RETRY_BACKOFF, OUTBOX_MAX_ATTEMPTS, OUTBOX_MAX_IN_FLIGHT);
     self->integration_test      = false;
     self->notification_override = 0;
     self->name                  = NULL;
@@ -146,18 +172,26 @@ void fty_alert_actions_destroy(fty_alert_actions_t** self_p)
         if (NULL != self->client) {
             mlm_client_destroy(&self->client);
         }
-        if (NULL != self->requestreply_poller) {
-            zpoller_destroy(&self->requestreply_poller);
-        }
         if (NULL != self->requestreply_client) {
             mlm_client_destroy(&self->requestreply_client);
         }
         if (NULL != self->alerts_cache) {
-            zhash_destroy(&self->alerts_cache);
+            for (auto& it : self->alerts_cache->by_rule) {
+                delete_alert_cache_item(it.second);
+            }
+            delete self->alerts_cache;
         }
         if (NULL != self->assets_cache) {
-            zhash_destroy(&self->assets_cache);
+            delete self->assets_cache;
+        }
+        if (NULL != self->pending_requests) {
+            zhash_destroy(&self->pending_requests);
         }
+        if (NULL != self->pending_assets) {
+            zhash_destroy(&self->pending_assets);
+        }
+        delete self->outbox;
+        delete self->timers;
         if (NULL != self->requestreply_name) {
             zstr_free(&self->requestreply_name);
         }
@@ -176,7 +210,7 @@ uint64_t get_alert_interval(s_alert_cache* alert_cache, uint64_t override_time)
         return override_time;
     }
     std::string severity = fty_proto_severity(alert_cache->alert_msg);
-    uint8_t     priority = static_cast<uint8_t>(fty_proto_aux_number(alert_cache->related_asset, "priority", 0));
+    uint8_t     priority = alert_cache->related_asset->priority;
     std::pair<std::string, uint8_t> key = {severity, priority};
     auto                            it  = times.find(key);
     if (it != times.end()) {
@@ -187,6 +221,49 @@ uint64_t get_alert_interval(s_alert_cache* alert_cache, uint64_t override_time)
 }
 
 
+//  --------------------------------------------------------------------------
+//  Calculate alert interval of cache item, alerts without asset are not repeated
+
+static uint64_t s_alert_interval(fty_alert_actions_t* self, s_alert_cache* alert_cache)
+{
+    if (NULL == alert_cache->related_asset) {
+        return self->notification_override;
+    }
+    return get_alert_interval(alert_cache, self->notification_override);
+}
+
+
+//  --------------------------------------------------------------------------
+//  Earliest time something has to be done with cache item: resolve it once
+//  ttl elapses or repeat notifications
+//  Both happen only after their time passed, the deadline is the first ms they are due
+
+static uint64_t s_alert_deadline(s_alert_cache* alert_cache)
+{
+    uint64_t deadline = alert_cache->last_received + static_cast<uint64_t>(fty_proto_ttl(alert_cache->alert_msg)) * 1000;
+    if (0 != alert_cache->interval && alert_cache->last_notification + alert_cache->interval < deadline) {
+        deadline = alert_cache->last_notification + alert_cache->interval;
+    }
+    return deadline + 1;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Make sure cache item has timer entry firing no later than its deadline
+//  Deadlines moving later need no new entry, the item is re-evaluated when
+//  the earlier one fires
+
+static void s_schedule_alert(fty_alert_actions_t* self, s_alert_cache* alert_cache)
+{
+    uint64_t deadline = s_alert_deadline(alert_cache);
+    if (0 != alert_cache->scheduled && alert_cache->scheduled <= deadline) {
+        return;
+    }
+    alert_cache->scheduled = deadline;
+    self->timers->push(s_alert_timer(deadline, fty_proto_rule(alert_cache->alert_msg)));
+}
+
+
 //  --------------------------------------------------------------------------
 //  Create new cache object
 
@@ -197,43 +274,22 @@ s_alert_cache* new_alert_cache_item(fty_alert_actions_t* self, fty_proto_t* msg)
     assert(fty_proto_name(msg));
     s_alert_cache* c     = static_cast<s_alert_cache*>(malloc(sizeof(s_alert_cache)));
     c->alert_msg         = msg;
-    c->last_notification = static_cast<uint64_t>(zclock_mono());
+    c->last_notification = static_cast<uint64_t>(Clock::mono());
     c->last_received     = c->last_notification;
     log_debug("searching for %s", fty_proto_name(msg));
 
-    c->related_asset = static_cast<fty_proto_t*>(zhash_lookup(self->assets_cache, fty_proto_name(msg)));
+    auto asset       = self->assets_cache->by_name.find(fty_proto_name(msg));
+    c->related_asset = (asset != self->assets_cache->by_name.end()) ? &asset->second : NULL;
     if (NULL == c->related_asset && !self->integration_test) {
-        // we don't know an asset we receieved alert about, ask fty-asset about it
-        log_debug("ask ASSET AGENT for ASSET_DETAIL about %s", fty_proto_name(msg));
-        zuuid_t* uuid = zuuid_new();
-        mlm_client_sendtox(self->requestreply_client, FTY_ASSET_AGENT_ADDRESS, "ASSET_DETAIL", "GET",
-            zuuid_str_canonical(uuid), fty_proto_name(msg), NULL);
-        void* which = zpoller_wait(self->requestreply_poller, static_cast<int>(self->requestreply_timeout));
-        if (which == NULL) {
-            log_warning("no response from ASSET AGENT, ignoring this alert.");
-            free(c);
-            c = NULL;
-        } else {
-            zmsg_t* reply_msg = mlm_client_recv(self->requestreply_client);
-            char*   rcv_uuid  = zmsg_popstr(reply_msg);
-            if (0 == strcmp(rcv_uuid, zuuid_str_canonical(uuid)) && fty_proto_is(reply_msg)) {
-                log_debug("received alert for unknown asset, asked for it and was successful.");
-                fty_proto_t* reply_proto_msg = fty_proto_decode(&reply_msg);
-                s_handle_stream_deliver_asset(self, &reply_proto_msg, mlm_client_subject(self->client));
-                c->related_asset = static_cast<fty_proto_t*>(zhash_lookup(self->assets_cache, fty_proto_name(msg)));
-            } else {
-                log_warning("received alert for unknown asset, ignoring.");
-                if (reply_msg) {
-                    zmsg_destroy(&reply_msg);
-                }
-                free(c);
-                c = NULL;
-                // msg will be destroy by caller
-            }
-            zstr_free(&rcv_uuid);
-        }
-        zuuid_destroy(&uuid);
+        // unknown assets are resolved by s_request_asset_detail before we get here
+        log_warning("received alert for unknown asset, ignoring.");
+        free(c);
+        c = NULL;
+        // msg will be destroy by caller
+        return c;
     }
+    c->interval  = s_alert_interval(self, c);
+    c->scheduled = 0;
     return c;
 }
 
@@ -248,59 +304,172 @@ void delete_alert_cache_item(void* c)
 }
 
 
+//  --------------------------------------------------------------------------
+//  Create or refresh cached record of the asset, returns the record
+
+s_asset_record* update_asset_record(fty_alert_actions_t* self, fty_proto_t* asset)
+{
+    const char*     contact_email = fty_proto_ext_string(asset, "contact_email", "");
+    const char*     contact_phone = fty_proto_ext_string(asset, "contact_phone", "");
+    s_asset_record& record        = self->assets_cache->by_name[fty_proto_name(asset)];
+    record.name                   = fty_proto_name(asset);
+    record.ext_name               = fty_proto_ext_string(asset, "name", "");
+    record.contact_email          = contact_email;
+    record.contact_sms            = fty_proto_ext_string(asset, "contact_sms", "");
+    record.priority_str           = fty_proto_aux_string(asset, "priority", "");
+    record.priority               = static_cast<uint8_t>(fty_proto_aux_number(asset, "priority", 0));
+
+    record.contacts_hash = std::hash<std::string>()(std::string(contact_email) + '\n' + contact_phone);
+    return &record;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Find cached alert by rule name, NULL if there is none
+
+s_alert_cache* lookup_alert_cache_item(fty_alert_actions_t* self, const char* rule)
+{
+    auto it = self->alerts_cache->by_rule.find(rule);
+    return (it != self->alerts_cache->by_rule.end()) ? it->second : NULL;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Store new cache object under rule name, cache takes ownership
+
+void insert_alert_cache_item(fty_alert_actions_t* self, const char* rule, s_alert_cache* item)
+{
+    self->alerts_cache->by_rule[rule] = item;
+    self->alerts_cache->by_asset[fty_proto_name(item->alert_msg)].insert(rule);
+}
+
+
+//  --------------------------------------------------------------------------
+//  Remove cache object stored under rule name and destroy it
+
+void remove_alert_cache_item(fty_alert_actions_t* self, const char* rule)
+{
+    auto it = self->alerts_cache->by_rule.find(rule);
+    if (it == self->alerts_cache->by_rule.end()) {
+        return;
+    }
+    s_alert_cache* item  = it->second;
+    auto           rules = self->alerts_cache->by_asset.find(fty_proto_name(item->alert_msg));
+    if (rules != self->alerts_cache->by_asset.end()) {
+        rules->second.erase(it->first);
+        if (rules->second.empty()) {
+            self->alerts_cache->by_asset.erase(rules);
+        }
+    }
+    self->alerts_cache->by_rule.erase(it);
+    delete_alert_cache_item(item);
+}
+
+
+//  --------------------------------------------------------------------------
+//  Cached alerts related to the asset
+
+static std::vector<s_alert_cache*> s_alerts_of_asset(fty_alert_actions_t* self, s_asset_record* asset)
+{
+    std::vector<s_alert_cache*> alerts;
+    auto                        rules = self->alerts_cache->by_asset.find(asset->name);
+    if (rules == self->alerts_cache->by_asset.end()) {
+        return alerts;
+    }
+    for (const auto& rule : rules->second) {
+        s_alert_cache* it = lookup_alert_cache_item(self, rule.c_str());
+        if (NULL != it && it->related_asset == asset) {
+            alerts.push_back(it);
+        }
+    }
+    return alerts;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Destroy pending asset object, alerts parked on it are dropped
+
+void delete_pending_asset_item(void* p)
+{
+    s_pending_asset* pending = static_cast<s_pending_asset*>(p);
+    fty_proto_t*     alert   = static_cast<fty_proto_t*>(zlist_pop(pending->alerts));
+    while (NULL != alert) {
+        fty_proto_destroy(&alert);
+        alert = static_cast<fty_proto_t*>(zlist_pop(pending->alerts));
+    }
+    zlist_destroy(&pending->alerts);
+    zstr_free(&pending->uuid);
+    zstr_free(&pending->asset_name);
+    free(pending);
+}
+
+
+//  --------------------------------------------------------------------------
+//  Park alert about unknown asset until fty-asset tells us about the asset
+//  Only one ASSET_DETAIL request is outstanding per asset, alerts share it
+
+static void s_request_asset_detail(fty_alert_actions_t* self, fty_proto_t** alert_p)
+{
+    const char*      assetname = fty_proto_name(*alert_p);
+    s_pending_asset* pending   = static_cast<s_pending_asset*>(zhash_lookup(self->pending_assets, assetname));
+    if (NULL == pending) {
+        // we don't know an asset we receieved alert about, ask fty-asset about it
+        log_debug("ask ASSET AGENT for ASSET_DETAIL about %s", assetname);
+        zuuid_t* uuid    = zuuid_new();
+        zmsg_t*  request = zmsg_new();
+        zmsg_addstr(request, "GET");
+        zmsg_addstr(request, zuuid_str_canonical(uuid));
+        zmsg_addstr(request, assetname);
+        if (self->requestreply_send(self, FTY_ASSET_AGENT_ADDRESS, "ASSET_DETAIL", &request) != 0) {
+            log_error("cannot send ASSET_DETAIL message, ignoring this alert.");
+            zmsg_destroy(&request);
+            zuuid_destroy(&uuid);
+            fty_proto_destroy(alert_p);
+            return;
+        }
+        pending             = static_cast<s_pending_asset*>(zmalloc(sizeof(s_pending_asset)));
+        pending->uuid       = strdup(zuuid_str_canonical(uuid));
+        pending->asset_name = strdup(assetname);
+        pending->deadline   = static_cast<uint64_t>(Clock::mono()) + self->requestreply_timeout;
+        pending->alerts     = zlist_new();
+        zuuid_destroy(&uuid);
+
+        zhash_insert(self->pending_assets, pending->asset_name, pending);
+        zhash_freefn(self->pending_assets, pending->asset_name, delete_pending_asset_item);
+        zhash_insert(self->pending_requests, pending->uuid, pending);
+    } else {
+        log_debug("ASSET_DETAIL about %s already requested, parking alert", assetname);
+    }
+    zlist_append(pending->alerts, *alert_p);
+    *alert_p = NULL;
+}
+
+
 //  --------------------------------------------------------------------------
 //  Send email containing alert message
 
 void send_email(fty_alert_actions_t* self, s_alert_cache* alert_item, char action_email)
 {
-    log_debug("sending SENDMAIL_ALERT/SENDSMS_ALERT for %s", fty_proto_name(alert_item->alert_msg));
+    log_debug("queueing SENDMAIL_ALERT/SENDSMS_ALERT for %s", fty_proto_name(alert_item->alert_msg));
     fty_proto_t* alert_dup = fty_proto_dup(alert_item->alert_msg);
     zmsg_t*      email_msg = fty_proto_encode(&alert_dup);
-    zuuid_t*     uuid      = zuuid_new();
     std::string  subject;
-    const char*  sname = fty_proto_ext_string(alert_item->related_asset, "name", "");
+    std::string  contact;
+    const char*  sname = alert_item->related_asset->ext_name.c_str();
     if (EMAIL_ACTION_VALUE == action_email) {
-        const char* contact_email = fty_proto_ext_string(alert_item->related_asset, "contact_email", "");
-        zmsg_pushstr(email_msg, contact_email);
+        contact = alert_item->related_asset->contact_email;
         subject = "SENDMAIL_ALERT";
     } else {
-        const char* contact_sms = fty_proto_ext_string(alert_item->related_asset, "contact_sms", "");
-        zmsg_pushstr(email_msg, contact_sms);
+        contact = alert_item->related_asset->contact_sms;
         subject = "SENDSMS_ALERT";
     }
-    const char* priority = fty_proto_aux_string(alert_item->related_asset, "priority", "");
+    zmsg_pushstr(email_msg, contact.c_str());
     zmsg_pushstr(email_msg, sname);
-    zmsg_pushstr(email_msg, priority);
-    zmsg_pushstr(email_msg, zuuid_str_canonical(uuid));
+    zmsg_pushstr(email_msg, alert_item->related_asset->priority_str.c_str());
     const char* address = (self->integration_test) ? FTY_EMAIL_AGENT_ADDRESS_TEST : FTY_EMAIL_AGENT_ADDRESS;
-    int         rv = mlm_client_sendto(self->requestreply_client, address, subject.c_str(), NULL, 5000, &email_msg);
-    if (rv != 0) {
-        log_error("cannot send %s message", subject.c_str());
-        zuuid_destroy(&uuid);
-        zmsg_destroy(&email_msg);
-        return;
-    }
-    void* which = zpoller_wait(self->requestreply_poller, static_cast<int>(self->requestreply_timeout));
-    if (which == NULL) {
-        log_error("received no reply on %s message", subject.c_str());
-    } else {
-        zmsg_t* reply_msg = mlm_client_recv(self->requestreply_client);
-        char*   rcv_uuid  = zmsg_popstr(reply_msg);
-        if (0 == strcmp(rcv_uuid, zuuid_str_canonical(uuid))) {
-            char* cmd = zmsg_popstr(reply_msg);
-            if (0 != strcmp(cmd, "OK")) {
-                char* cause = zmsg_popstr(reply_msg);
-                log_error("%s failed due to %s", subject.c_str(), cause);
-                zstr_free(&cause);
-            }
-            zstr_free(&cmd);
-        } else {
-            log_error("received invalid reply on %s message", subject.c_str());
-        }
-        zstr_free(&rcv_uuid);
-        zmsg_destroy(&reply_msg);
-    }
-    zuuid_destroy(&uuid);
+    // newer state of the same alert for the same contact supersedes the unsent one
+    std::string key = std::string(address) + "/" + subject + "/" + contact + "/" + fty_proto_rule(alert_item->alert_msg);
+    self->outbox->enqueue(address, subject, key, &email_msg, static_cast<uint64_t>(Clock::mono()));
 }
 
 
@@ -309,39 +478,14 @@ void send_email(fty_alert_actions_t* self, s_alert_cache* alert_item, char actio
 
 void send_gpo_action(fty_alert_actions_t* self, char* gpo_iname, char* gpo_state)
 {
-    log_debug("sending GPO_INTERACTION to %s", gpo_iname);
-    zuuid_t*    zuuid   = zuuid_new();
+    log_debug("queueing GPO_INTERACTION to %s", gpo_iname);
     const char* address = (self->integration_test) ? FTY_SENSOR_GPIO_AGENT_ADDRESS_TEST : FTY_SENSOR_GPIO_AGENT_ADDRESS;
-
-    int rv = mlm_client_sendtox(
-        self->requestreply_client, address, "GPO_INTERACTION", zuuid_str_canonical(zuuid), gpo_iname, gpo_state, NULL);
-
-    if (rv != 0) {
-        log_error("cannot send GPO_INTERACTION message");
-        return;
-    }
-    void* which = zpoller_wait(self->requestreply_poller, static_cast<int>(self->requestreply_timeout));
-    if (which == NULL) {
-        log_error("received no reply on GPO_INTERACTION message");
-    } else {
-        zmsg_t* reply_msg = mlm_client_recv(self->requestreply_client);
-        char*   zuuid_str = zmsg_popstr(reply_msg);
-        if (streq(zuuid_str, zuuid_str_canonical(zuuid))) {
-            char* cmd = zmsg_popstr(reply_msg);
-            if (0 == strcmp(cmd, "OK")) {
-                log_debug("GPO_INTERACTION successful");
-            } else {
-                char* cause = zmsg_popstr(reply_msg);
-                log_error("GPO_INTERACTION failed due to %s", cause);
-                zstr_free(&cause);
-            }
-            zstr_free(&cmd);
-        } else
-            log_error("received invalid reply on GPO_INTERACTION message");
-        zstr_free(&zuuid_str);
-        zmsg_destroy(&reply_msg);
-    }
-    zuuid_destroy(&zuuid);
+    zmsg_t*     gpo_msg = zmsg_new();
+    zmsg_addstr(gpo_msg, gpo_iname);
+    zmsg_addstr(gpo_msg, gpo_state);
+    // only the last requested state of the GPO matters
+    std::string key = std::string(address) + "/" + GPO_ACTION + "/" + gpo_iname;
+    self->outbox->enqueue(address, GPO_ACTION, key, &gpo_msg, static_cast<uint64_t>(Clock::mono()));
 }
 
 
@@ -512,37 +656,67 @@ void action_resolve(fty_alert_actions_t* self, s_alert_cache* alert_item)
 
 
 //  --------------------------------------------------------------------------
-//  Check for timed out alerts, resolve them and delete them
+//  Process alerts whose deadline passed: resolve and delete timed out ones,
+//  resend the others periodically based on times table - severity and priority
 
-void check_timed_out_alerts(fty_alert_actions_t* self)
+void check_alert_timers(fty_alert_actions_t* self, uint64_t now)
 {
-    s_alert_cache* it  = static_cast<s_alert_cache*>(zhash_first(self->alerts_cache));
-    uint64_t       now = static_cast<uint64_t>(zclock_mono());
-    while (NULL != it) {
-        if (it->last_received + (fty_proto_ttl(it->alert_msg) * 1000) < now) {
+    while (!self->timers->empty() && self->timers->top().first <= now) {
+        s_alert_timer timer = self->timers->top();
+        self->timers->pop();
+        s_alert_cache* it = lookup_alert_cache_item(self, timer.second.c_str());
+        if (NULL == it || it->scheduled != timer.first) {
+            // alert is gone or was rescheduled since
+            continue;
+        }
+        it->scheduled = 0;
+        if (it->last_received + static_cast<uint64_t>(fty_proto_ttl(it->alert_msg)) * 1000 < now) {
             log_debug("found timed out alert from %s - resolving it", fty_proto_name(it->alert_msg));
             action_resolve(self, it);
-            zhash_delete(self->alerts_cache, zhash_cursor(self->alerts_cache));
+            remove_alert_cache_item(self, timer.second.c_str());
+            continue;
+        }
+        if (0 != it->interval && it->last_notification + it->interval < now) {
+            it->last_notification = now;
+            action_alert_repeat(self, it);
         }
-        it = static_cast<s_alert_cache*>(zhash_next(self->alerts_cache));
+        s_schedule_alert(self, it);
+    }
+}
+
+
+//  --------------------------------------------------------------------------
+//  Recompute alert intervals of all cached alerts, e.g. after override change
+
+static void s_reschedule_all_alerts(fty_alert_actions_t* self)
+{
+    for (auto& it : self->alerts_cache->by_rule) {
+        it.second->interval  = s_alert_interval(self, it.second);
+        it.second->scheduled = 0;
+        s_schedule_alert(self, it.second);
     }
 }
 
 
 //  --------------------------------------------------------------------------
-//  Resend alerts periodically based on times table - severity and priority
+//  Give up ASSET_DETAIL requests fty-asset did not answer in time
 
-void check_alerts_and_send_if_needed(fty_alert_actions_t* self)
+void check_pending_asset_requests(fty_alert_actions_t* self, uint64_t now)
 {
-    s_alert_cache* it  = static_cast<s_alert_cache*>(zhash_first(self->alerts_cache));
-    uint64_t       now = static_cast<uint64_t>(zclock_mono());
+    std::vector<std::string> expired;
+    s_pending_asset*         it = static_cast<s_pending_asset*>(zhash_first(self->pending_assets));
     while (NULL != it) {
-        uint64_t notification_delay = get_alert_interval(it, self->notification_override);
-        if (0 != notification_delay && (it->last_notification + notification_delay < now)) {
-            it->last_notification = static_cast<uint64_t>(zclock_mono());
-            action_alert_repeat(self, it);
+        if (it->deadline <= now) {
+            expired.push_back(it->asset_name);
         }
-        it = static_cast<s_alert_cache*>(zhash_next(self->alerts_cache));
+        it = static_cast<s_pending_asset*>(zhash_next(self->pending_assets));
+    }
+    for (const auto& assetname : expired) {
+        s_pending_asset* pending = static_cast<s_pending_asset*>(zhash_lookup(self->pending_assets, assetname.c_str()));
+        log_warning("no response from ASSET AGENT about %s, ignoring %zu alert(s).", assetname.c_str(),
+            zlist_size(pending->alerts));
+        zhash_delete(self->pending_requests, pending->uuid);
+        zhash_delete(self->pending_assets, assetname.c_str());
     }
 }
 
@@ -562,13 +736,23 @@ static void s_handle_stream_deliver_alert(fty_alert_actions_t* self, fty_proto_t
         log_warning("Message not FTY_PROTO_ALERT.");
         return;
     }
+    if (NULL != zhash_lookup(self->pending_assets, fty_proto_name(alert))) {
+        // keep the order of alerts about asset we are still asking for
+        s_request_asset_detail(self, alert_p);
+        return;
+    }
     s_alert_cache* search;
     const char*    rule = fty_proto_rule(alert);
-    search              = static_cast<s_alert_cache*>(zhash_lookup(self->alerts_cache, rule));
+    search              = lookup_alert_cache_item(self, rule);
     if (streq(fty_proto_state(alert), "ACTIVE") || streq(fty_proto_state(alert), "ACK-WIP") ||
         streq(fty_proto_state(alert), "ACK-PAUSE") || streq(fty_proto_state(alert), "ACK-IGNORE") ||
         streq(fty_proto_state(alert), "ACK-SILENCE")) {
         if (NULL == search) {
+            if (!self->integration_test && 0 == self->assets_cache->by_name.count(fty_proto_name(alert))) {
+                // alert is processed once fty-asset answers, the actor does not wait for it
+                s_request_asset_detail(self, alert_p);
+                return;
+            }
             // create new alert object in cache
             log_debug("new %s alarm  with subject %s, add it to database", fty_proto_state(alert), subject);
             search = new_alert_cache_item(self, alert);
@@ -576,11 +760,11 @@ static void s_handle_stream_deliver_alert(fty_alert_actions_t* self, fty_proto_t
                 fty_proto_destroy(alert_p);
                 return;
             }
-            zhash_insert(self->alerts_cache, rule, search);
-            zhash_freefn(self->alerts_cache, rule, delete_alert_cache_item);
+            insert_alert_cache_item(self, rule, search);
+            s_schedule_alert(self, search);
             action_alert(self, search);
         } else {
-            search->last_received = static_cast<uint64_t>(zclock_mono());
+            search->last_received = static_cast<uint64_t>(Clock::mono());
             char changed          = 0;
             // little more complicated, update cache, alert on changes
             if (streq(fty_proto_state(search->alert_msg), "ACTIVE") &&
@@ -612,6 +796,11 @@ static void s_handle_stream_deliver_alert(fty_alert_actions_t* self, fty_proto_t
             }
             fty_proto_destroy(&search->alert_msg);
             search->alert_msg = alert;
+            if (1 == changed) {
+                // severity might have changed, so does the interval
+                search->interval = s_alert_interval(self, search);
+                s_schedule_alert(self, search);
+            }
             if (1 == changed) {
                 log_debug("known alarm resolved as updated, sending notifications");
                 action_alert(self, search);
@@ -619,10 +808,10 @@ static void s_handle_stream_deliver_alert(fty_alert_actions_t* self, fty_proto_t
         }
     } else if (streq(fty_proto_state(alert), "RESOLVED")) {
         if (NULL != search) {
-            search->last_received = static_cast<uint64_t>(zclock_mono());
+            search->last_received = static_cast<uint64_t>(Clock::mono());
             action_resolve(self, search);
             log_debug("received RESOLVED alarm with subject %s resolved", subject);
-            zhash_delete(self->alerts_cache, rule);
+            remove_alert_cache_item(self, rule);
         }
         // we don't care about alerts that are resolved and not stored - were never active
         fty_proto_destroy(alert_p);
@@ -656,63 +845,51 @@ static void s_handle_stream_deliver_asset(
     if (streq(operation, FTY_PROTO_ASSET_OP_DELETE) ||
         !streq(fty_proto_aux_string(asset, FTY_PROTO_ASSET_STATUS, "active"), "active")) {
         log_debug("received delete for asset %s", assetname);
-        fty_proto_t* item = static_cast<fty_proto_t*>(zhash_lookup(self->assets_cache, assetname));
-        if (NULL != item) {
-            s_alert_cache* it = static_cast<s_alert_cache*>(zhash_first(self->alerts_cache));
-            while (NULL != it) {
-                if (it->related_asset == item) {
-                    // delete all alerts related to deleted asset
-                    action_resolve(self, it);
-                    zhash_delete(self->alerts_cache, zhash_cursor(self->alerts_cache));
-                }
-                it = static_cast<s_alert_cache*>(zhash_next(self->alerts_cache));
+        auto item = self->assets_cache->by_name.find(assetname);
+        if (item != self->assets_cache->by_name.end()) {
+            for (s_alert_cache* it : s_alerts_of_asset(self, &item->second)) {
+                // delete all alerts related to deleted asset
+                action_resolve(self, it);
+                std::string rule = fty_proto_rule(it->alert_msg);
+                remove_alert_cache_item(self, rule.c_str());
             }
-            zhash_delete(self->assets_cache, assetname);
+            self->assets_cache->by_name.erase(item);
         }
         fty_proto_destroy(asset_p);
     } else if (streq(operation, FTY_PROTO_ASSET_OP_UPDATE)) {
         log_debug("received update for asset %s", assetname);
-        fty_proto_t* known = static_cast<fty_proto_t*>(zhash_lookup(self->assets_cache, assetname));
+        auto            item  = self->assets_cache->by_name.find(assetname);
+        s_asset_record* known = (item != self->assets_cache->by_name.end()) ? &item->second : NULL;
         if (NULL != known) {
-            char changed = 0;
-            if (!streq(fty_proto_ext_string(known, "contact_email", ""),
-                    fty_proto_ext_string(asset, "contact_email", "")) ||
-                !streq(fty_proto_ext_string(known, "contact_phone", ""),
-                    fty_proto_ext_string(asset, "contact_phone", ""))) {
-                changed = 1;
-            }
+            size_t  contacts_hash = known->contacts_hash;
+            uint8_t priority      = known->priority;
+            known                 = update_asset_record(self, asset);
+            fty_proto_destroy(asset_p);
+            char changed = (contacts_hash != known->contacts_hash) ? 1 : 0;
             if (1 == changed) {
                 // simple workaround to handle alerts for assets changed during alert being active
                 log_debug("known asset was updated, resolving previous alert");
-                s_alert_cache* it = static_cast<s_alert_cache*>(zhash_first(self->alerts_cache));
-                while (NULL != it) {
-                    if (it->related_asset == known) {
-                        // just resolve, will be activated again
-                        action_resolve(self, it);
-                    }
-                    it = static_cast<s_alert_cache*>(zhash_next(self->alerts_cache));
+                for (s_alert_cache* it : s_alerts_of_asset(self, known)) {
+                    // just resolve, will be activated again
+                    action_resolve(self, it);
+                }
+            }
+            if (priority != known->priority) {
+                for (s_alert_cache* it : s_alerts_of_asset(self, known)) {
+                    it->interval = s_alert_interval(self, it);
+                    s_schedule_alert(self, it);
                 }
             }
-            zhash_t* tmp_ext = fty_proto_get_ext(asset);
-            zhash_t* tmp_aux = fty_proto_get_aux(asset);
-            fty_proto_set_ext(known, &tmp_ext);
-            fty_proto_set_aux(known, &tmp_aux);
-            assetname = fty_proto_name(known);
-            fty_proto_destroy(asset_p);
             if (1 == changed) {
                 log_debug("known asset was updated, sending notifications");
-                s_alert_cache* it = static_cast<s_alert_cache*>(zhash_first(self->alerts_cache));
-                while (NULL != it) {
-                    if (it->related_asset == known) {
-                        // force an alert since contact info changed
-                        action_alert(self, it);
-                    }
-                    it = static_cast<s_alert_cache*>(zhash_next(self->alerts_cache));
+                for (s_alert_cache* it : s_alerts_of_asset(self, known)) {
+                    // force an alert since contact info changed
+                    action_alert(self, it);
                 }
             }
         } else {
-            zhash_insert(self->assets_cache, assetname, asset);
-            zhash_freefn(self->assets_cache, assetname, fty_proto_destroy_wrapper);
+            update_asset_record(self, asset);
+            fty_proto_destroy(asset_p);
         }
     } else {
         // 'create' is skipped because each is followed by an 'update'
@@ -742,6 +919,60 @@ void s_handle_stream_deliver(fty_alert_actions_t* self, zmsg_t** msg_p, const ch
 }
 
 
+//  --------------------------------------------------------------------------
+//  Handle replies on requestreply client: ASSET_DETAIL replies release alerts
+//  parked on the asset, other ones answer queued notifications
+
+void s_handle_requestreply_deliver(fty_alert_actions_t* self, zmsg_t** msg_p)
+{
+    assert(self);
+    assert(msg_p);
+    zmsg_t* reply_msg = *msg_p;
+    char*   rcv_uuid  = zmsg_popstr(reply_msg);
+    s_pending_asset* pending =
+        (NULL == rcv_uuid) ? NULL : static_cast<s_pending_asset*>(zhash_lookup(self->pending_requests, rcv_uuid));
+    if (NULL == pending) {
+        if (NULL != rcv_uuid && self->outbox->handleReply(rcv_uuid, msg_p, static_cast<uint64_t>(Clock::mono()))) {
+            zstr_free(&rcv_uuid);
+            return;
+        }
+        log_warning("received reply with unexpected correlation id, ignoring");
+        zstr_free(&rcv_uuid);
+        zmsg_destroy(msg_p);
+        return;
+    }
+    zstr_free(&rcv_uuid);
+
+    // take over parked alerts, the request is done whatever the answer is
+    zlist_t*    alerts    = pending->alerts;
+    std::string assetname = pending->asset_name;
+    pending->alerts       = zlist_new();
+    zhash_delete(self->pending_requests, pending->uuid);
+    zhash_delete(self->pending_assets, assetname.c_str());
+
+    if (fty_proto_is(reply_msg)) {
+        log_debug("received alert for unknown asset, asked for it and was successful.");
+        fty_proto_t* reply_proto_msg = fty_proto_decode(msg_p);
+        s_handle_stream_deliver_asset(self, &reply_proto_msg, "ASSET_DETAIL");
+    } else {
+        zmsg_destroy(msg_p);
+    }
+
+    bool         known = (0 != self->assets_cache->by_name.count(assetname));
+    fty_proto_t* alert = static_cast<fty_proto_t*>(zlist_pop(alerts));
+    while (NULL != alert) {
+        if (known) {
+            s_handle_stream_deliver_alert(self, &alert, "");
+        } else {
+            log_warning("received alert for unknown asset, ignoring.");
+            fty_proto_destroy(&alert);
+        }
+        alert = static_cast<fty_proto_t*>(zlist_pop(alerts));
+    }
+    zlist_destroy(&alerts);
+}
+
+
 //  --------------------------------------------------------------------------
 //  Handle incoming alerts through pipe
 
@@ -792,6 +1023,7 @@ static int s_handle_pipe_deliver(fty_alert_actions_t* self, zmsg_t** msg_p, uint
         char* rcvd = zmsg_popstr(msg);
         sscanf(rcvd, "%" SCNu64, &(self->notification_override));
         zstr_free(&rcvd);
+        s_reschedule_all_alerts(self);
     }
     zstr_free(&cmd);
     zmsg_destroy(&msg);
@@ -812,25 +1044,37 @@ void fty_alert_actions(zsock_t* pipe, void* args)
     self->requestreply_name    = zsys_sprintf("%s#mb", self->name);
     self->requestreply_timeout = 1000; // hopefully 1ms will be long enough to get input
 
-    zpoller_t* poller          = zpoller_new(pipe, mlm_client_msgpipe(self->client), NULL);
+    zpoller_t* poller =
+        zpoller_new(pipe, mlm_client_msgpipe(self->client), mlm_client_msgpipe(self->requestreply_client), NULL);
     assert(poller);
 
     uint64_t timeout = 1000 * 10 * 1; // timeout every 10 seconds
     zsock_signal(pipe, 0);
 
-    zmsg_t*  msg         = NULL;
-    uint64_t check_delay = 1000 * 60 * 1; // check every minute
-    uint64_t last        = static_cast<uint64_t>(zclock_mono());
+    zmsg_t* msg = NULL;
 
     while (!zsys_interrupted) {
-        void*    which = zpoller_wait(poller, static_cast<int>(timeout));
-        uint64_t now   = static_cast<uint64_t>(zclock_mono());
-        if (now - last >= check_delay) {
-            log_debug("performing periodic check");
-            last = now;
-            check_timed_out_alerts(self);
-            check_alerts_and_send_if_needed(self);
+        // the clock is read once per loop and passed down
+        uint64_t mono = static_cast<uint64_t>(Clock::mono());
+        check_alert_timers(self, mono);
+        check_pending_asset_requests(self, mono);
+        self->outbox->checkTimeouts(mono);
+        self->outbox->dispatch(mono);
+
+        // don't oversleep alert deadlines, outstanding requests and queued notifications
+        uint64_t wait = timeout;
+        if (zhash_size(self->pending_assets) > 0 && self->requestreply_timeout < wait) {
+            wait = self->requestreply_timeout;
+        }
+        if (!self->timers->empty()) {
+            uint64_t due = self->timers->top().first;
+            wait         = (due <= mono) ? 0 : std::min(wait, due - mono);
+        }
+        int64_t next = self->outbox->timeToNext(mono);
+        if (next >= 0 && static_cast<uint64_t>(next) < wait) {
+            wait = static_cast<uint64_t>(next);
         }
+        void* which = zpoller_wait(poller, static_cast<int>(wait));
         if (which == NULL) {
             if (zpoller_terminated(poller) || zsys_interrupted) {
                 log_warning("zpoller_terminated () or zsys_interrupted. Shutting down.");
@@ -847,6 +1091,12 @@ void fty_alert_actions(zsock_t* pipe, void* args)
                 break;
             }
         }
+        // replies to ASSET_DETAIL requests and notifications
+        if (which == mlm_client_msgpipe(self->requestreply_client)) {
+            msg = mlm_client_recv(self->requestreply_client);
+            s_handle_requestreply_deliver(self, &msg);
+            continue;
+        }
         msg = mlm_client_recv(self->client);
         // stream messages - receieve ASSETS and ALERTS
         if (fty_proto_is(msg)) {
@@ -22,28 +22,76 @@
 
 #include <malamute.h>
 #include <fty_proto.h>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+class NotificationOutbox;
+struct s_alert_timers;
+
+///  Asset fields needed for notifications
+typedef struct
+{
+    std::string name;          // asset iname
+    std::string ext_name;      // user friendly name
+    std::string contact_email;
+    std::string contact_sms;
+    std::string priority_str;  // priority as received, forwarded in notifications
+    uint8_t     priority;      // 0 when asset has none
+    size_t      contacts_hash; // hash of contacts, detects their change
+} s_asset_record;
+
+typedef struct
+{
+    fty_proto_t*    alert_msg;
+    uint64_t        last_notification;
+    uint64_t        last_received;
+    s_asset_record* related_asset;
+    uint64_t        interval;  // re-notification interval, 0 when alert is not repeated
+    uint64_t        scheduled; // deadline of the live entry in timers, 0 when there is none
+} s_alert_cache;
+
+///  Alerts by rule name with secondary index by asset name, so that asset
+///  changes touch only alerts of that asset
+struct s_alerts_cache
+{
+    std::unordered_map<std::string, s_alert_cache*>                  by_rule;  // owns the items
+    std::unordered_map<std::string, std::unordered_set<std::string>> by_asset; // asset name -> rule names
+};
+
+///  Assets by name, records keep their address while they are cached
+struct s_assets_cache
+{
+    std::unordered_map<std::string, s_asset_record> by_name;
+};
 
 typedef struct _fty_alert_actions_t
 {
-    mlm_client_t* client;
-    mlm_client_t* requestreply_client;
-    zpoller_t*    requestreply_poller;
-    zhash_t*      alerts_cache;
-    zhash_t*      assets_cache;
-    char*         name;
-    char*         requestreply_name;
-    bool          integration_test;
-    uint64_t      notification_override;
-    uint64_t      requestreply_timeout;
+    mlm_client_t*       client;
+    mlm_client_t*       requestreply_client;
+    //  sends ASSET_DETAIL requests and notifications through requestreply_client, tests replace it
+    int (*requestreply_send)(
+        struct _fty_alert_actions_t* self, const char* address, const char* subject, zmsg_t** msg_p);
+    s_alerts_cache*     alerts_cache;
+    s_assets_cache*     assets_cache;
+    zhash_t*            pending_assets;   // asset name -> s_pending_asset, owns the items
+    zhash_t*            pending_requests; // ASSET_DETAIL correlation id -> s_pending_asset
+    NotificationOutbox* outbox;           // queued and unanswered e-mail, SMS and GPO requests
+    s_alert_timers*     timers;           // re-notification and expiry deadlines of alerts_cache items
+    char*               name;
+    char*               requestreply_name;
+    bool                integration_test;
+    uint64_t            notification_override;
+    uint64_t            requestreply_timeout;
 } fty_alert_actions_t;
 
 typedef struct
 {
-    fty_proto_t* alert_msg;
-    uint64_t     last_notification;
-    uint64_t     last_received;
-    fty_proto_t* related_asset;
-} s_alert_cache;
+    char*    uuid;       // correlation id of the outstanding ASSET_DETAIL request
+    char*    asset_name; // asset we asked fty-asset about
+    uint64_t deadline;   // zclock_mono() time when the request is given up
+    zlist_t* alerts;     // fty_proto_t alerts parked until the asset is known
+} s_pending_asset;
 
 ///  Create a new fty_alert_actions
 fty_alert_actions_t* fty_alert_actions_new(void);
@@ -57,4 +105,12 @@ void fty_alert_actions(zsock_t* pipe, void* args);
 uint64_t get_alert_interval(s_alert_cache* alert_cache, uint64_t override_time = 0);
 s_alert_cache* new_alert_cache_item(fty_alert_actions_t* self, fty_proto_t* msg);
 void delete_alert_cache_item(void* c);
+s_asset_record* update_asset_record(fty_alert_actions_t* self, fty_proto_t* asset);
+s_alert_cache* lookup_alert_cache_item(fty_alert_actions_t* self, const char* rule);
+void insert_alert_cache_item(fty_alert_actions_t* self, const char* rule, s_alert_cache* item);
+void remove_alert_cache_item(fty_alert_actions_t* self, const char* rule);
+void delete_pending_asset_item(void* p);
 void s_handle_stream_deliver(fty_alert_actions_t* self, zmsg_t** msg_p, const char* subject);
+void s_handle_requestreply_deliver(fty_alert_actions_t* self, zmsg_t** msg_p);
+void check_pending_asset_requests(fty_alert_actions_t* self, uint64_t now);
+void check_alert_timers(fty_alert_actions_t* self, uint64_t now);
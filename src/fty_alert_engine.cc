@@ -77,6 +77,8 @@ int main(int argc, char** argv)
 
     // initialize log for auditability
     AuditLogManager::init(ENGINE_AGENT_NAME);
+    // rule evaluations are formatted and written by a background thread
+    AuditLogManager::startAsync();
 
     zactor_t* ag_server_stream =
         zactor_new(fty_alert_engine_stream, static_cast<void*>(const_cast<char*>(ENGINE_AGENT_NAME_STREAM)));
@@ -95,6 +97,11 @@ int main(int argc, char** argv)
     zstr_sendx(ag_server_stream, "CONSUMER", FTY_PROTO_STREAM_METRICS_UNAVAILABLE, ".*", NULL);
     zstr_sendx(ag_server_stream, "CONSUMER", FTY_PROTO_STREAM_METRICS_SENSOR, "status.*", NULL);
     zstr_sendx(ag_server_stream, "CONSUMER", FTY_PROTO_STREAM_LICENSING_ANNOUNCEMENTS, ".*", NULL);
+    // metrics for fty-alert-engine-replay
+    const char* record = config ? zconfig_get(config, "server/record", NULL) : NULL;
+    if (record && *record) {
+        zstr_sendx(ag_server_stream, "RECORD", record, NULL);
+    }
 
     // autoconfig
     zactor_t* ag_configurator = zactor_new(autoconfig, static_cast<void*>(const_cast<char*>(AUTOCONFIG_NAME)));
@@ -20,10 +20,225 @@
 */
 
 #include "fty_alert_engine_audit_log.h"
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
 #include <stdio.h>
+#include <thread>
+#include <unordered_map>
+#include <utility>
 
 Ftylog* AuditLogManager::_auditLogger = nullptr;
 
+// bounded lock-free queue of records, any number of producers and one consumer
+// (D. Vyukov's bounded MPMC queue)
+class AuditQueue
+{
+public:
+    // capacity is rounded up to a power of two
+    explicit AuditQueue(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        _mask  = size - 1;
+        _slots = std::unique_ptr<Slot[]>(new Slot[size]);
+        for (size_t i = 0; i < size; i++) {
+            _slots[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // false when the queue is full
+    bool push(const AuditRecord& record)
+    {
+        size_t pos = _tail.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot&    slot = _slots[pos & _mask];
+            size_t   seq  = slot.seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.record = record;
+                    slot.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = _tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // false when the queue is empty, called by the consumer only
+    bool pop(AuditRecord& record)
+    {
+        size_t pos  = _head.load(std::memory_order_relaxed);
+        Slot&  slot = _slots[pos & _mask];
+        if (slot.seq.load(std::memory_order_acquire) != pos + 1) {
+            return false;
+        }
+        record = slot.record;
+        slot.seq.store(pos + _mask + 1, std::memory_order_release);
+        _head.store(pos + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // called by the consumer only
+    bool empty() const
+    {
+        size_t pos = _head.load(std::memory_order_relaxed);
+        return _slots[pos & _mask].seq.load(std::memory_order_acquire) != pos + 1;
+    }
+
+    // position after the last record pushed (or being pushed)
+    size_t tail() const
+    {
+        return _tail.load(std::memory_order_relaxed);
+    }
+
+    // position of the next record to pop
+    size_t head() const
+    {
+        return _head.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Slot
+    {
+        std::atomic<size_t> seq;
+        AuditRecord         record;
+    };
+
+    size_t                  _mask;
+    std::unique_ptr<Slot[]> _slots;
+    alignas(64) std::atomic<size_t> _tail{0};
+    alignas(64) std::atomic<size_t> _head{0};
+};
+
+// rules known to records
+struct AuditRule
+{
+    std::string              name;
+    std::vector<std::string> metrics;
+    std::string              key;  // in auditRuleIds
+    uint32_t                 refs; // ruleId() not released yet, 0 when released
+};
+
+static std::mutex                                auditRulesMutex;
+static std::unordered_map<uint32_t, AuditRule>   auditRules;    // id | rule
+static std::unordered_map<std::string, uint32_t> auditRuleIds;  // name and metrics | id of the rule in use
+static uint32_t                                  auditNextId = 0;
+static std::vector<uint32_t>                     auditReleased; // released in async mode, not erased yet
+
+// async mode
+static std::unique_ptr<AuditQueue> auditQueue;
+static std::thread                 auditWriter;
+static std::atomic<bool>           auditAsync{false}; // records go to auditQueue
+static std::atomic<bool>           auditStop{false};
+static std::atomic<uint64_t>       auditDropped{0};
+static std::mutex                  auditWakeMutex;
+static std::condition_variable     auditWake;
+static std::atomic<bool>           auditWaiting{false}; // writer waits for records
+
+// writes the record to the audit log
+static void s_audit_write(const AuditRecord& record)
+{
+    std::string name, values;
+    {
+        std::lock_guard<std::mutex> lock(auditRulesMutex);
+        auto                        it = auditRules.find(record.rule);
+        if (it == auditRules.end()) {
+            return;
+        }
+        const AuditRule& rule = it->second;
+        name                  = rule.name;
+        for (uint32_t i = 0; i < record.count; i++) {
+            if (!values.empty()) {
+                values += ", ";
+            }
+            if (i == AuditRecord::MAX_VALUES) {
+                values += "...";
+                break;
+            }
+            values += (i < rule.metrics.size()) ? rule.metrics[i] : "?";
+            if (std::isnan(record.values[i])) {
+                values += " = NaN";
+            } else {
+                char buf[32];
+                snprintf(buf, sizeof(buf), " = %g", record.values[i]);
+                values += buf;
+            }
+        }
+    }
+    log_info_alarms_engine_audit(
+        "Evaluate rule '%s' [%s] -> %s %s", name.c_str(), values.c_str(), record.status, record.severity);
+}
+
+// waits until a record is queued or the writer is stopped
+static void s_audit_wait()
+{
+    std::unique_lock<std::mutex> lock(auditWakeMutex);
+    auditWaiting.store(true, std::memory_order_relaxed);
+    // pairs with the fence in audit(): either the producer sees auditWaiting or the queue is not empty here
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auditWake.wait(lock, [] {
+        return auditStop.load(std::memory_order_acquire) || !auditQueue->empty();
+    });
+    auditWaiting.store(false, std::memory_order_relaxed);
+}
+
+static void s_audit_writer()
+{
+    AuditRecord                              record;
+    uint64_t                                 reported = 0;
+    std::vector<std::pair<uint32_t, size_t>> released; // rule | queue position after its last record
+    for (;;) {
+        // records pushed before stop are drained below
+        bool stop = auditStop.load(std::memory_order_acquire);
+        {
+            std::lock_guard<std::mutex> lock(auditRulesMutex);
+            for (uint32_t rule : auditReleased) {
+                released.emplace_back(rule, auditQueue->tail());
+            }
+            auditReleased.clear();
+        }
+        while (auditQueue->pop(record)) {
+            s_audit_write(record);
+        }
+        if (!released.empty()) {
+            // records of the rule are written, unless some were still being pushed
+            size_t                      head = auditQueue->head();
+            std::lock_guard<std::mutex> lock(auditRulesMutex);
+            released.erase(std::remove_if(released.begin(), released.end(),
+                               [head, stop](const std::pair<uint32_t, size_t>& it) {
+                                   if (!stop && it.second > head) {
+                                       return false;
+                                   }
+                                   auditRules.erase(it.first);
+                                   return true;
+                               }),
+                released.end());
+        }
+        uint64_t dropped = auditDropped.load(std::memory_order_relaxed);
+        if (dropped != reported) {
+            log_warning_alarms_engine_audit("%" PRIu64 " rule evaluations not logged, audit queue full",
+                dropped - reported);
+            reported = dropped;
+        }
+        if (stop) {
+            break;
+        }
+        s_audit_wait();
+    }
+}
+
 //  init audit logger
 void AuditLogManager::init(const std::string& serviceName, const std::string& confFileName)
 {
@@ -44,6 +259,21 @@ void AuditLogManager::init(const std::string& serviceName, const std::string& co
 //  deinit audit logger
 void AuditLogManager::deinit()
 {
+    if (auditWriter.joinable()) {
+        auditAsync.store(false, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> lock(auditWakeMutex);
+            auditStop.store(true, std::memory_order_release);
+        }
+        auditWake.notify_one();
+        auditWriter.join();
+        // queue is drained, rules released meanwhile have no records left
+        std::lock_guard<std::mutex> lock(auditRulesMutex);
+        for (uint32_t rule : auditReleased) {
+            auditRules.erase(rule);
+        }
+        auditReleased.clear();
+    }
     if (_auditLogger) {
         ftylog_delete(_auditLogger);
         _auditLogger = nullptr;
@@ -55,3 +285,88 @@ Ftylog* AuditLogManager::getInstance()
 {
     return _auditLogger;
 }
+
+//  start async mode
+void AuditLogManager::startAsync(size_t capacity)
+{
+    if (auditWriter.joinable()) {
+        return;
+    }
+    auditQueue.reset(new AuditQueue(capacity));
+    auditStop.store(false, std::memory_order_relaxed);
+    auditDropped.store(0, std::memory_order_relaxed);
+    auditWriter = std::thread(s_audit_writer);
+    auditAsync.store(true, std::memory_order_release);
+}
+
+//  return number of dropped records
+uint64_t AuditLogManager::dropped()
+{
+    return auditDropped.load(std::memory_order_relaxed);
+}
+
+//  return id of the rule
+uint32_t AuditLogManager::ruleId(const std::string& name, const std::vector<std::string>& metrics)
+{
+    std::string key = name;
+    for (const auto& metric : metrics) {
+        key += '\0';
+        key += metric;
+    }
+
+    std::lock_guard<std::mutex> lock(auditRulesMutex);
+    auto                        it = auditRuleIds.find(key);
+    if (it != auditRuleIds.end()) {
+        auditRules[it->second].refs++;
+        return it->second;
+    }
+    // ids of released rules are not reused, their records may still be queued
+    while (auditRules.count(auditNextId) != 0) {
+        auditNextId++;
+    }
+    uint32_t id = auditNextId++;
+    auditRules.emplace(id, AuditRule{name, metrics, key, 1});
+    auditRuleIds.emplace(std::move(key), id);
+    return id;
+}
+
+//  release id of the rule
+void AuditLogManager::releaseRule(uint32_t rule)
+{
+    std::lock_guard<std::mutex> lock(auditRulesMutex);
+    auto                        it = auditRules.find(rule);
+    if (it == auditRules.end() || it->second.refs == 0 || --it->second.refs != 0) {
+        return;
+    }
+    auditRuleIds.erase(it->second.key);
+    if (auditAsync.load(std::memory_order_acquire)) {
+        // erased by the writer once it has written the queued records
+        auditReleased.push_back(rule);
+    } else {
+        auditRules.erase(it);
+    }
+}
+
+//  write evaluation of the rule
+void AuditLogManager::audit(
+    uint32_t rule, const std::vector<double>& values, const char* status, const char* severity)
+{
+    AuditRecord record;
+    record.rule  = rule;
+    record.count = static_cast<uint32_t>(values.size());
+    std::copy_n(values.begin(), std::min(values.size(), AuditRecord::MAX_VALUES), record.values);
+    snprintf(record.status, sizeof(record.status), "%s", status);
+    snprintf(record.severity, sizeof(record.severity), "%s", severity);
+
+    if (!auditAsync.load(std::memory_order_acquire)) {
+        s_audit_write(record);
+    } else if (!auditQueue->push(record)) {
+        auditDropped.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (auditWaiting.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(auditWakeMutex);
+            auditWake.notify_one();
+        }
+    }
+}
@@ -21,7 +21,11 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <fty_log.h>
+#include <string>
+#include <vector>
 
 /* Prints message in Audit Log with DEBUG level. */
 #define log_debug_alarms_engine_audit(...) log_debug_log(AuditLogManager::getInstance(), __VA_ARGS__);
@@ -38,6 +42,19 @@
 /* Prints message in Audit Log with FATAL level. */
 #define log_fatal_alarms_engine_audit(...) log_fatal_log(AuditLogManager::getInstance(), __VA_ARGS__);
 
+// evaluation of a rule, written to the audit log as
+// "Evaluate rule '<rule>' [<metric> = <value>, ...] -> <status> <severity>"
+struct AuditRecord
+{
+    static constexpr size_t MAX_VALUES = 8; // more values are written as "..."
+
+    uint32_t rule;               // AuditLogManager::ruleId()
+    uint32_t count;              // number of input values, can be more than MAX_VALUES
+    double   values[MAX_VALUES]; // input values in the order of rule metrics
+    char     status[16];         // alert status (truncated)
+    char     severity[32];       // alert severity (truncated)
+};
+
 // singleton for audit logger management
 class AuditLogManager
 {
@@ -51,5 +68,23 @@ public:
     static Ftylog* getInstance();
     static void    init(const std::string& serviceName,
                         const std::string& confFileName = FTY_COMMON_LOGGING_DEFAULT_CFG);
+    // flushes the records of async mode, if any
+    // call it when rules are no longer evaluated
     static void    deinit();
+
+    // starts async mode: records are queued (and dropped when the queue is full)
+    // and written by a background thread, until deinit()
+    // call it before rules are evaluated
+    static void     startAsync(size_t capacity = 16384);
+    // number of records dropped since startAsync()
+    static uint64_t dropped();
+
+    // id of the rule in AuditRecord, the same for the same name and metrics
+    // until the rule is released as many times as its id was taken
+    static uint32_t ruleId(const std::string& name, const std::vector<std::string>& metrics);
+    // the rule of ruleId() is no longer evaluated, records already written for it are still logged
+    static void     releaseRule(uint32_t rule);
+    // writes evaluation of the rule, the last value is NaN when a metric was missing
+    static void     audit(uint32_t rule, const std::vector<double>& values, const char* status,
+                          const char* severity);
 };
@@ -0,0 +1,111 @@
+/*  =========================================================================
+    fty_alert_engine_replay - Replays recorded metrics into rules, offline
+
+    Copyright (C) 2014 - 2021 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#include "fty_alert_engine_server.h"
+#include <cinttypes>
+#include <czmq.h>
+#include <fty_log.h>
+
+// path to the directory, where rules are stored. Attention: without last slash!
+static const char* PATH = "/var/lib/fty/fty-alert-engine";
+
+int main(int argc, char** argv)
+{
+    const char* rules     = PATH;
+    const char* output    = NULL;
+    const char* recording = NULL;
+
+    ManageFtyLog::setInstanceFtylog("fty-alert-engine-replay", FTY_COMMON_LOGGING_DEFAULT_CFG);
+
+    int argn;
+    for (argn = 1; argn < argc; argn++) {
+        char* par = NULL;
+        if (argn < argc - 1)
+            par = argv[argn + 1];
+
+        if (streq(argv[argn], "-v") || streq(argv[argn], "--verbose")) {
+            ManageFtyLog::getInstanceFtylog()->setVerboseMode();
+        }
+        else if (streq(argv[argn], "-h") || streq(argv[argn], "--help")) {
+            puts("fty-alert-engine-replay [option] [value] recording");
+            puts("   -v|--verbose          verbose output");
+            puts("   -h|--help             print help");
+            puts("   -r|--rules [path]     directory with rules (default /var/lib/fty/fty-alert-engine)");
+            puts("   -o|--output [path]    write alerts to the file, - for standard output");
+            puts("recording is written by fty-alert-engine with server/record set in its configuration");
+            return 0;
+        }
+        else if ((streq(argv[argn], "-r") || streq(argv[argn], "--rules")) && par) {
+            rules = par;
+            ++argn;
+        }
+        else if ((streq(argv[argn], "-o") || streq(argv[argn], "--output")) && par) {
+            output = par;
+            ++argn;
+        }
+        else if (argv[argn][0] != '-' && !recording) {
+            recording = argv[argn];
+        }
+        else {
+            printf("Unknown option: %s, run with -h|--help \n", argv[argn]);
+            return 1;
+        }
+    }
+    if (!recording) {
+        puts("recording is missing, run with -h|--help");
+        return 1;
+    }
+
+    FILE* alerts = NULL;
+    if (output) {
+        alerts = streq(output, "-") ? stdout : fopen(output, "w");
+        if (!alerts) {
+            printf("can't create %s\n", output);
+            return 1;
+        }
+    }
+
+    ReplayStats stats;
+    int         rv = replay_metrics(recording, rules, alerts, stats);
+    if (alerts && alerts != stdout) {
+        fclose(alerts);
+    }
+    clearEvaluateMetrics();
+    if (rv != 0) {
+        printf("can't read recording %s\n", recording);
+        return 1;
+    }
+
+    double seconds = static_cast<double>(stats.time) / 1e6;
+    fprintf(stderr, "cycles: %" PRIu64 "\n", stats.cycles);
+    fprintf(stderr, "metrics: %" PRIu64 "\n", stats.metrics);
+    fprintf(stderr, "evaluations: %" PRIu64 "\n", stats.evaluations);
+    fprintf(stderr, "alerts: %" PRIu64 "\n", stats.alerts);
+    fprintf(stderr, "time: %.3f s\n", seconds);
+    if (seconds > 0) {
+        fprintf(stderr, "metrics/s: %.0f\n", static_cast<double>(stats.metrics) / seconds);
+        fprintf(stderr, "evaluations/s: %.0f\n", static_cast<double>(stats.evaluations) / seconds);
+    }
+    if (stats.truncated) {
+        fprintf(stderr, "recording ends with a damaged record, replayed up to it\n");
+    }
+    return 0;
+}
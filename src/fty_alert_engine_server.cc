@@ -21,10 +21,24 @@
 
 #include "fty_alert_engine_server.h"
 #include "alertconfiguration.h"
+#include "clock.h"
+#include "debuglog.h"
+#include "latencyhistogram.h"
+#include "logthrottle.h"
+#include "luarule.h"
+#include "metricrecording.h"
+#include "probes.h"
 #include "autoconfig.h"
+#include "rulechannel.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cxxtools/jsonserializer.h>
 #include <fty_shm.h>
 #include <mutex>
 #include <functional>
+#include <tuple>
 
 #define METRICS_STREAM "METRICS"
 
@@ -41,6 +55,55 @@ static std::mutex mtxAlertConfig;
 // map to know if a metric is evaluted or not
 static std::map<std::string, bool> evaluateMetrics;
 
+// number of rules in STATS reply when the request doesn't say
+#define STATS_DEFAULT_TOP 20
+
+// totals of metric_processing, written by the stream actor and read by STATS in the mailbox
+static struct
+{
+    std::atomic<uint64_t> cycles{0};
+    std::atomic<uint64_t> metrics{0};   // metrics read in the last cycle
+    std::atomic<uint64_t> evaluated{0}; // metrics evaluated in the last cycle
+    std::atomic<uint64_t> time{0};      // wall time of the last cycle, us
+    std::atomic<uint64_t> totalTime{0}; // us
+    std::atomic<uint64_t> maxTime{0};   // us
+} cycleStats;
+
+// asset of the metrics about the engine itself
+#define SELF_METRICS_ASSET "fty-alert-engine"
+// memory of Lua states is summed over all rules under mtxAlertConfig, only every this many cycles
+#define SELF_METRICS_LUA_MEMORY_CYCLES 10
+
+// counters of the current polling cycle for self metrics, guarded by mtxAlertConfig
+static struct
+{
+    uint64_t         evaluations = 0;
+    uint64_t         alerts      = 0;
+    LatencyHistogram evaluationTime; // ns
+} selfStats;
+
+// age of metrics (now - metric time) when processed, ms, guarded by mtxAlertConfig
+static struct
+{
+    LatencyHistogram                        ingest;     // read from SHM
+    LatencyHistogram                        evaluation; // rules evaluated
+    LatencyHistogram                        publish;    // alert published
+    std::map<std::string, LatencyHistogram> publishByClass;
+} latencies;
+
+// age of metric of time (in s) at now (in ms), ms
+static uint64_t s_metric_age(uint64_t time, int64_t now)
+{
+    return (time && now > int64_t(time) * 1000) ? uint64_t(now) - time * 1000 : 0;
+}
+
+// errors repeated every polling cycle, by metric name and by rule name
+static LogThrottle metricErrors;
+static LogThrottle evaluateErrors;
+
+// takes alerts instead of the stream when set, see replay_metrics()
+static std::function<void(const std::string& rule, const PureAlert& alert)> alertSink;
+
 void clearEvaluateMetrics()
 {
     evaluateMetrics.clear();
@@ -133,6 +196,98 @@ void get_rule(mlm_client_t* client, const char* name, AlertConfiguration& ac)
     mlm_client_sendto(client, mlm_client_sender(client), RULES_SUBJECT, mlm_client_tracker(client), 1000, &reply);
 }
 
+// static
+void get_stats(mlm_client_t* client, const char* sort, const char* top, AlertConfiguration& ac)
+{
+    static const std::map<std::string, std::function<uint64_t(const RuleStats&)>> sortKeys = {
+        {"time", [](const RuleStats& s) { return s.totalTime; }},
+        {"max", [](const RuleStats& s) { return s.maxTime; }},
+        {"average", [](const RuleStats& s) { return s.evaluations ? s.totalTime / s.evaluations : 0; }},
+        {"evaluations", [](const RuleStats& s) { return s.evaluations; }},
+        {"skipped", [](const RuleStats& s) { return s.skipped; }},
+        {"errors", [](const RuleStats& s) { return s.errors; }},
+        {"alerts", [](const RuleStats& s) { return s.alerts; }},
+    };
+
+    auto key = sortKeys.find(sort);
+    if (key == sortKeys.end()) {
+        log_warning("sort '%s' is invalid", sort);
+        zmsg_t* reply = zmsg_new();
+        zmsg_addstr(reply, "ERROR");
+        zmsg_addstr(reply, "INVALID_SORT");
+        mlm_client_sendto(client, mlm_client_sender(client), RULES_SUBJECT, mlm_client_tracker(client), 1000, &reply);
+        return;
+    }
+    size_t count = top ? strtoul(top, NULL, 10) : STATS_DEFAULT_TOP; // 0 means all
+
+    std::vector<std::pair<std::string, RuleStats>> rules;
+    mtxAlertConfig.lock();
+    rules.reserve(ac.size());
+    for (const auto& i : ac) {
+        rules.emplace_back(i.first, i.second.first->stats());
+    }
+    mtxAlertConfig.unlock();
+
+    if (count == 0 || count > rules.size()) {
+        count = rules.size();
+    }
+    std::partial_sort(rules.begin(), rules.begin() + static_cast<long>(count), rules.end(),
+        [&key](const std::pair<std::string, RuleStats>& a, const std::pair<std::string, RuleStats>& b) {
+            uint64_t va = key->second(a.second), vb = key->second(b.second);
+            return (va != vb) ? va > vb : a.first < b.first;
+        });
+
+    auto latency = [](cxxtools::SerializationInfo& si, const LatencyHistogram& histogram) {
+        si.addMember("count") <<= histogram.count();
+        si.addMember("p50") <<= histogram.percentile(50);
+        si.addMember("p99") <<= histogram.percentile(99);
+        si.addMember("max") <<= histogram.max();
+    };
+    auto json = [](const cxxtools::SerializationInfo& si) {
+        std::stringstream        s;
+        cxxtools::JsonSerializer js(s);
+        js.serialize(si).finish();
+        return s.str();
+    };
+
+    zmsg_t* reply = zmsg_new();
+    zmsg_addstr(reply, "STATS");
+    zmsg_addstr(reply, sort);
+    {
+        // polling cycles
+        cxxtools::SerializationInfo si;
+        si.addMember("cycles") <<= cycleStats.cycles.load();
+        si.addMember("metrics") <<= cycleStats.metrics.load();
+        si.addMember("evaluated") <<= cycleStats.evaluated.load();
+        si.addMember("time_us") <<= cycleStats.time.load();
+        si.addMember("total_time_us") <<= cycleStats.totalTime.load();
+        si.addMember("max_time_us") <<= cycleStats.maxTime.load();
+        // metric age at each stage, ms
+        mtxAlertConfig.lock();
+        latency(si.addMember("ingest_latency_ms"), latencies.ingest);
+        latency(si.addMember("evaluation_latency_ms"), latencies.evaluation);
+        latency(si.addMember("publish_latency_ms"), latencies.publish);
+        cxxtools::SerializationInfo& byClass = si.addMember("publish_latency_by_class_ms");
+        for (const auto& i : latencies.publishByClass) {
+            latency(byClass.addMember(i.first.empty() ? "none" : i.first), i.second);
+        }
+        mtxAlertConfig.unlock();
+        zmsg_addstr(reply, json(si).c_str());
+    }
+    for (size_t i = 0; i < count; i++) {
+        const RuleStats&            stats = rules[i].second;
+        cxxtools::SerializationInfo si;
+        si.addMember("name") <<= rules[i].first;
+        si.addMember("evaluations") <<= stats.evaluations;
+        si.addMember("skipped") <<= stats.skipped;
+        si.addMember("errors") <<= stats.errors;
+        si.addMember("alerts") <<= stats.alerts;
+        si.addMember("time_us") <<= stats.totalTime / 1000;
+        si.addMember("max_time_us") <<= stats.maxTime / 1000;
+        zmsg_addstr(reply, json(si).c_str());
+    }
+    mlm_client_sendto(client, mlm_client_sender(client), RULES_SUBJECT, mlm_client_tracker(client), 1000, &reply);
+}
 
 // XXX: Store the actions as zlist_t internally to avoid useless copying
 zlist_t* makeActionList(const std::vector<std::string>& actions)
@@ -145,20 +300,36 @@ zlist_t* makeActionList(const std::vector<std::string>& actions)
 }
 
 // static
-void send_alerts(mlm_client_t* client, const std::vector<PureAlert>& alertsToSend, const std::string& rule_name)
+void send_alerts(mlm_client_t* client, const std::vector<PureAlert>& alertsToSend, const std::string& rule_name,
+    int64_t nowMs = Clock::timeMs())
 {
+    uint64_t now = static_cast<uint64_t>(nowMs / 1000);
     for (const auto& alert : alertsToSend) {
         // Asset id is missing in the rule name for warranty alarms
         std::string fullRuleName = rule_name;
         if (streq("warranty", fullRuleName.c_str())) {
             fullRuleName += "@" + alert._element;
         }
+        trace_probe4(alert_publish, fullRuleName.c_str(), alert._element.c_str(), alert._status.c_str(),
+            s_metric_age(alert._metricTime, nowMs));
+        if (alertSink) {
+            alertSink(fullRuleName, alert);
+            continue;
+        }
 
+        // time of the triggering metric, consumers can measure their lag
+        zhash_t* aux = NULL;
+        if (alert._metricTime) {
+            aux = zhash_new();
+            zhash_autofree(aux);
+            zhash_insert(aux, "metric_time", const_cast<char*>(std::to_string(alert._metricTime).c_str()));
+        }
         zlist_t* actions = makeActionList(alert._actions);
-        zmsg_t*  msg     = fty_proto_encode_alert(NULL, static_cast<uint64_t>(::time(NULL)),
-            static_cast<uint32_t>(alert._ttl), fullRuleName.c_str(), alert._element.c_str(), alert._status.c_str(),
-            alert._severity.c_str(), alert._description.c_str(), actions);
+        zmsg_t*  msg     = fty_proto_encode_alert(aux, now, static_cast<uint32_t>(alert._ttl),
+            fullRuleName.c_str(), alert._element.c_str(), alert._status.c_str(), alert._severity.c_str(),
+            alert._description.c_str(), actions);
         zlist_destroy(&actions);
+        zhash_destroy(&aux);
         if (msg) {
             std::string atopic = rule_name + "/" + alert._severity + "@" + alert._element;
             mlm_client_send(client, atopic.c_str(), &msg);
@@ -169,9 +340,10 @@ void send_alerts(mlm_client_t* client, const std::vector<PureAlert>& alertsToSen
 }
 
 // static
-void send_alerts(mlm_client_t* client, const std::vector<PureAlert>& alertsToSend, const RulePtr& rule)
+void send_alerts(mlm_client_t* client, const std::vector<PureAlert>& alertsToSend, const RulePtr& rule,
+    int64_t nowMs = Clock::timeMs())
 {
-    send_alerts(client, alertsToSend, rule->name());
+    send_alerts(client, alertsToSend, rule->name(), nowMs);
 }
 
 // static
@@ -275,6 +447,40 @@ void add_rule(mlm_client_t* client, const char* json_representation, AlertConfig
 }
 
 // static
+// adds rules queued by autoconfig of this process (see RuleChannel), nobody waits for a reply
+void add_queued_rules(AlertConfiguration& ac)
+{
+    for (auto& rule : RuleChannel::take()) {
+        std::string                  rule_name = rule->name();
+        std::set<std::string>        newSubjectsToSubscribe;
+        std::vector<PureAlert>       alertsToSend;
+        AlertConfiguration::iterator new_rule_it;
+
+        mtxAlertConfig.lock();
+        int rv = ac.addRule(std::move(rule), newSubjectsToSubscribe, alertsToSend, new_rule_it);
+        mtxAlertConfig.unlock();
+
+        switch (rv) {
+            case 0:
+                log_debug("rule '%s' added correctly", rule_name.c_str());
+                break;
+            case -2:
+                log_debug("rule '%s' already exists", rule_name.c_str());
+                break;
+            case -6:
+                log_error("rule '%s' not added, operating with storage/disk failed", rule_name.c_str());
+                break;
+            case -100:
+            case -101:
+                log_debug("rule '%s' instanciation rejected", rule_name.c_str());
+                break;
+            default:
+                log_error("rule '%s' not added (%d)", rule_name.c_str(), rv);
+                break;
+        }
+    }
+}
+
 void update_rule(mlm_client_t* client, const char* json_representation, const char* rule_name, AlertConfiguration& ac)
 {
     std::istringstream           f(json_representation);
@@ -449,8 +655,9 @@ void check_metrics(mlm_client_t* client, const char* metric_topic, AlertConfigur
 }
 
 // static
+// nowMs is the time of the polling cycle, the clock is not read per rule
 bool evaluate_metric(mlm_client_t* client, const MetricInfo& triggeringMetric, const MetricList& knownMetricValues,
-    AlertConfiguration& ac)
+    AlertConfiguration& ac, int64_t nowMs)
 {
     // Go through all known rules, and try to evaluate them
     mtxAlertConfig.lock();
@@ -465,30 +672,48 @@ bool evaluate_metric(mlm_client_t* client, const MetricInfo& triggeringMetric, c
 
     const std::vector<std::string> rules_of_metric = ac.getRulesByMetric(sTopic);
 
-    log_debug(" ### evaluate topic '%s' (rules size: %zu)", sTopic.c_str(), rules_of_metric.size());
+    log_debug_hot(" ### evaluate topic '%s' (rules size: %zu)", sTopic.c_str(), rules_of_metric.size());
 
     for (const auto& rulename : rules_of_metric) {
         if (ac.count(rulename) == 0) {
-            log_error("Rule %s must exist but was not found", rulename.c_str());
+            log_error_throttled(evaluateErrors, rulename, "Rule %s must exist but was not found", rulename.c_str());
             continue;
         }
 
         auto&       it_ac = ac.at(rulename);
         const auto& rule  = it_ac.first;
-        log_debug(" ### Evaluate rule '%s'", rule->name().c_str());
+        log_debug_hot(" ### Evaluate rule '%s'", rule->name().c_str());
 
+        // counters are guarded by mtxAlertConfig, held here anyway
+        RuleStats& stats   = rule->stats();
+        uint64_t   skipped = stats.skipped;
+        stats.evaluations++;
         try {
             isEvaluate = true;
+            trace_probe2(rule_evaluate_start, rulename.c_str(), sTopic.c_str());
             PureAlert pureAlert;
-            int       rv = rule->evaluate(knownMetricValues, pureAlert);
+            auto      start   = std::chrono::steady_clock::now();
+            int       rv      = rule->evaluate(knownMetricValues, pureAlert);
+            uint64_t  elapsed = static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+            trace_probe4(rule_evaluate_end, rulename.c_str(), sTopic.c_str(), rv, elapsed);
+            stats.totalTime += elapsed;
+            stats.maxTime = std::max(stats.maxTime, elapsed);
+            selfStats.evaluations++;
+            selfStats.evaluationTime.add(elapsed);
+            latencies.evaluation.add(s_metric_age(triggeringMetric.getTimestamp(), nowMs));
             if (rv != 0) {
-                log_error(" ### Cannot evaluate the rule '%s'", rule->name().c_str());
+                if (stats.skipped == skipped) {
+                    stats.errors++;
+                }
+                log_error_throttled(evaluateErrors, rulename, " ### Cannot evaluate the rule '%s'", rulename.c_str());
                 continue;
             }
 
             PureAlert alertToSend;
-            rv               = ac.updateAlert(it_ac, pureAlert, alertToSend);
-            alertToSend._ttl = triggeringMetric.getTtl() * 3;
+            rv                      = ac.updateAlert(it_ac, pureAlert, alertToSend);
+            alertToSend._ttl        = triggeringMetric.getTtl() * 3;
+            alertToSend._metricTime = triggeringMetric.getTimestamp();
 
             // NOTE: Warranty rule is not processed by configurator which adds info about asset. In order to send the
             // corrent message to stream alert description is modified
@@ -516,21 +741,34 @@ bool evaluate_metric(mlm_client_t* client, const MetricInfo& triggeringMetric, c
             }
 
             if (rv == -1) {
-                log_debug(" ### alert updated, nothing to send");
+                log_debug_hot(" ### alert updated, nothing to send");
                 // nothing to send
                 continue;
             }
-            send_alerts(client, {alertToSend}, rule);
+            send_alerts(client, {alertToSend}, rule, nowMs);
+            stats.alerts++;
+            selfStats.alerts++;
+            uint64_t age = s_metric_age(alertToSend._metricTime, nowMs);
+            latencies.publish.add(age);
+            latencies.publishByClass[rule->rule_class()].add(age);
         } catch (const std::exception& e) {
-            log_error("CANNOT evaluate rule, because '%s'", e.what());
+            stats.errors++;
+            log_error_throttled(
+                evaluateErrors, rulename, "CANNOT evaluate rule '%s', because '%s'", rulename.c_str(), e.what());
         }
     }
     mtxAlertConfig.unlock();
     return isEvaluate;
 }
 
-void metric_processing(fty::shm::shmMetrics& result, MetricList& cache, mlm_client_t* client)
+void metric_processing(fty::shm::shmMetrics& result, MetricList& cache, mlm_client_t* client, int64_t nowMs)
 {
+    // cycle time set by the caller, it is the same for all metrics of the cycle
+    uint64_t         now       = cache.time();
+    auto             start     = std::chrono::steady_clock::now();
+    uint64_t         evaluated = 0;
+    LatencyHistogram ingest; // merged at the end, the lock isn't taken per metric
+
     // process accumulated stream messages
     for (auto& element : result) {
         // std::string topic = element.first;
@@ -542,7 +780,7 @@ void metric_processing(fty::shm::shmMetrics& result, MetricList& cache, mlm_clie
         const char* value     = fty_proto_value(element);
         const char* unit      = fty_proto_unit(element);
         uint32_t    ttl       = fty_proto_ttl(element);
-        uint64_t    timestamp = fty_proto_aux_number(element, "time", static_cast<uint64_t>(::time(NULL)));
+        uint64_t    timestamp = fty_proto_aux_number(element, "time", now);
 
         // TODO: 2016-04-27 ACE: fix it later, when "string" values
         // in the metric would be considered as
@@ -553,46 +791,169 @@ void metric_processing(fty::shm::shmMetrics& result, MetricList& cache, mlm_clie
         if (errno == ERANGE) {
             errno = 0;
             // fty_proto_print (element);
-            log_error("%s: can't convert value to double #1, ignore message", name);
+            log_error_throttled(metricErrors, name, "%s: can't convert value to double #1, ignore message", name);
             continue;
         } else if (end == value || *end != '\0') {
             // fty_proto_print (element);
-            log_error("%s: can't convert value to double #2, ignore message", name);
+            log_error_throttled(metricErrors, name, "%s: can't convert value to double #2, ignore message", name);
             continue;
         }
 
-        log_debug("%s: Got message '%s@%s' with value %s", name, type, name, value);
+        log_debug_hot("%s: Got message '%s@%s' with value %s", name, type, name, value);
+
+        uint64_t age = s_metric_age(timestamp, nowMs);
+        ingest.add(age);
 
         // Update cache with new value
         MetricInfo m(name, type, unit, dvalue, timestamp, "", ttl);
         cache.addMetric(m);
 
         // search if this metric is already evaluated and if this metric is evaluate
-        std::map<std::string, bool>::iterator found       = evaluateMetrics.find(m.generateTopic());
+        std::string                           topic       = m.generateTopic();
+        std::map<std::string, bool>::iterator found       = evaluateMetrics.find(topic);
         bool                                  metricfound = found != evaluateMetrics.end();
+        trace_probe2(metric_ingest, topic.c_str(), age);
 
-        log_debug("Check metric : %s", m.generateTopic().c_str());
-        if (metricfound && ManageFtyLog::getInstanceFtylog()->isLogDebug()) {
-            log_debug("Metric '%s' is known and %s be evaluated", m.generateTopic().c_str(),
-                found->second ? "must" : "will not");
+        log_debug_hot("Check metric : %s", topic.c_str());
+        if (metricfound) {
+            log_debug_hot(
+                "Metric '%s' is known and %s be evaluated", topic.c_str(), found->second ? "must" : "will not");
         }
 
         if (!metricfound || found->second) {
-            bool isEvaluate = evaluate_metric(client, m, cache, alertConfiguration);
+            bool isEvaluate = evaluate_metric(client, m, cache, alertConfiguration, nowMs);
+            if (isEvaluate) {
+                evaluated++;
+            }
 
             // if the metric is evaluate for the first time, add to the list
             if (!metricfound) {
-                log_debug("Add %s evaluated metric '%s'", isEvaluate ? " " : "not", m.generateTopic().c_str());
-                evaluateMetrics[m.generateTopic()] = isEvaluate;
+                log_debug_hot("Add %s evaluated metric '%s'", isEvaluate ? " " : "not", topic.c_str());
+                evaluateMetrics[topic] = isEvaluate;
             }
         }
     }
+
+    uint64_t elapsed = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+    mtxAlertConfig.lock();
+    latencies.ingest.merge(ingest);
+    mtxAlertConfig.unlock();
+
+    cycleStats.cycles++;
+    cycleStats.metrics   = result.size();
+    cycleStats.evaluated = evaluated;
+    cycleStats.time      = elapsed;
+    cycleStats.totalTime += elapsed;
+    if (elapsed > cycleStats.maxTime) {
+        cycleStats.maxTime = elapsed;
+    }
+}
+
+// writes metrics about the polling cycle to SHM, so that they can be charted and watched by rules
+// @param[in] cycle - duration of the cycle, ms
+// @param[in] metrics - number of metrics read
+// @param[in] ttl - TTL of the metrics, s
+void publish_self_metrics(uint64_t cycle, size_t metrics, int ttl)
+{
+    // called by the stream actor only, the last sum is published until the next one
+    static size_t   luaMemory       = 0;
+    static unsigned luaMemoryCycles = 0;
+
+    uint64_t evaluations, alerts, p99;
+
+    mtxAlertConfig.lock();
+    evaluations = selfStats.evaluations;
+    alerts      = selfStats.alerts;
+    p99         = selfStats.evaluationTime.percentile(99);
+    selfStats   = {};
+    if (luaMemoryCycles++ % SELF_METRICS_LUA_MEMORY_CYCLES == 0) {
+        luaMemory = 0;
+        for (const auto& i : alertConfiguration) {
+            auto luaRule = dynamic_cast<LuaRule*>(i.second.first.get());
+            if (luaRule) {
+                luaMemory += luaRule->luaMemory();
+            }
+        }
+    }
+    mtxAlertConfig.unlock();
+
+    const std::vector<std::tuple<const char*, uint64_t, const char*>> values = {
+        {"alert_engine.cycle_time", cycle, "ms"},
+        {"alert_engine.metrics", metrics, ""},
+        {"alert_engine.evaluations", evaluations, ""},
+        {"alert_engine.evaluation_time.p99", p99 / 1000, "us"},
+        {"alert_engine.alerts", alerts, ""},
+        {"alert_engine.lua_memory", luaMemory / 1024, "kB"},
+    };
+    for (const auto& value : values) {
+        if (fty::shm::write_metric(SELF_METRICS_ASSET, std::get<0>(value), std::to_string(std::get<1>(value)),
+                std::get<2>(value), ttl) != 0) {
+            log_error_throttled(
+                metricErrors, std::get<0>(value), "can't write %s@%s to SHM", std::get<0>(value), SELF_METRICS_ASSET);
+        }
+    }
+}
+
+int replay_metrics(const char* recording, const char* rules_path, FILE* alerts, ReplayStats& stats)
+{
+    MetricRecording replay;
+    if (replay.open(recording) != 0) {
+        return -1;
+    }
+
+    alertConfiguration.setPath(rules_path);
+    alertConfiguration.readConfiguration();
+
+    stats     = {};
+    alertSink = [alerts, &stats](const std::string& rule, const PureAlert& alert) {
+        stats.alerts++;
+        if (alerts) {
+            fprintf(alerts, "%" PRIu64 "\t%s\t%s\t%s\t%s\t%s\n", Clock::time(), rule.c_str(), alert._element.c_str(),
+                alert._status.c_str(), alert._severity.c_str(), alert._description.c_str());
+        }
+    };
+
+    // same steps as the stream actor, in the recorded order and at the recorded time
+    MetricList   cache;
+    MetricRecord record;
+    auto         start = std::chrono::steady_clock::now();
+    while (replay.next(record)) {
+        Clock::simulate(record.time);
+        if (record.kind == MetricRecord::SNAPSHOT) {
+            fty::shm::shmMetrics result;
+            for (const auto& metric : record.metrics) {
+                result.add(metric.toProto());
+            }
+            cache.setTime(Clock::time());
+            cache.removeOldMetrics();
+            metric_processing(result, cache, NULL, record.time);
+            stats.cycles++;
+            stats.metrics += record.metrics.size();
+        } else {
+            check_metrics(NULL, record.topic.c_str(), alertConfiguration);
+        }
+    }
+    stats.time = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+    stats.truncated = replay.truncated();
+
+    mtxAlertConfig.lock();
+    for (const auto& i : alertConfiguration) {
+        stats.evaluations += i.second.first->stats().evaluations;
+    }
+    mtxAlertConfig.unlock();
+
+    alertSink = nullptr;
+    Clock::real();
+    return 0;
 }
 
 void fty_alert_engine_stream(zsock_t* pipe, void* args)
 {
-    MetricList cache; // need to track incoming measurements
-    char*      name = static_cast<char*>(args);
+    MetricList     cache;    // need to track incoming measurements
+    MetricRecorder recorder; // records what is processed when open, see RECORD
+    char*          name = static_cast<char*>(args);
 
     mlm_client_t* client = mlm_client_new();
     assert(client);
@@ -602,21 +963,29 @@ void fty_alert_engine_stream(zsock_t* pipe, void* args)
 
     int64_t timeout = fty_get_polling_interval() * 1000;
     zsock_signal(pipe, 0);
-    int64_t timeCash = zclock_mono();
+    int64_t timeCash = Clock::mono();
     log_info("Actor %s started", name);
     while (!zsys_interrupted) {
 
         // clear cache every "polling interval" sec
-        int64_t timeCurrent = zclock_mono() - timeCash;
+        int64_t timeCurrent = Clock::mono() - timeCash;
         if (timeCurrent >= timeout) {
             fty::shm::shmMetrics result;
+            int64_t              now = Clock::timeMs(); // time of the cycle
+            cache.setTime(static_cast<uint64_t>(now / 1000));
             cache.removeOldMetrics();
-            timeCash = zclock_mono();
+            timeCash = Clock::mono();
             // Timeout, need to get metrics and update refresh value
             fty::shm::read_metrics(".*", ".*", result);
             log_debug("number of metrics read : %d", result.size());
+            if (recorder.isOpen()) {
+                recorder.snapshot(now, result);
+            }
             timeout = fty_get_polling_interval() * 1000;
-            metric_processing(result, cache, client);
+            metric_processing(result, cache, client, now);
+            LogThrottle::flushAll();
+            publish_self_metrics(static_cast<uint64_t>(Clock::mono() - timeCash), result.size(),
+                static_cast<int>(fty_get_polling_interval() * 2));
         } else {
             timeout = timeout - timeCurrent;
         }
@@ -713,6 +1082,16 @@ void fty_alert_engine_stream(zsock_t* pipe, void* args)
                     log_error("%s: can't set consumer on stream '%s', '%s'", name, stream, pattern);
                 zstr_free(&pattern);
                 zstr_free(&stream);
+            } else if (streq(cmd, "RECORD")) {
+                // empty or missing file stops the recording
+                char* file = zmsg_popstr(msg);
+                if (file && *file) {
+                    recorder.open(file);
+                } else if (recorder.isOpen()) {
+                    log_info("%s: metric recording stopped", name);
+                    recorder.close();
+                }
+                zstr_free(&file);
             }
 
             zstr_free(&cmd);
@@ -735,6 +1114,9 @@ void fty_alert_engine_stream(zsock_t* pipe, void* args)
             if (streq(command, "METRICUNAVAILABLE")) {
                 char* metrictopic = zmsg_popstr(zmessage);
                 if (metrictopic) {
+                    if (recorder.isOpen()) {
+                        recorder.unavailable(Clock::timeMs(), metrictopic);
+                    }
                     check_metrics(client, metrictopic, alertConfiguration);
                 } else {
                     log_error("%s: Received stream command '%s', but message has bad format", name, command);
@@ -759,7 +1141,9 @@ void fty_alert_engine_mailbox(zsock_t* pipe, void* args)
     mlm_client_t* client = mlm_client_new();
     assert(client);
 
-    zpoller_t* poller = zpoller_new(pipe, mlm_client_msgpipe(client), NULL);
+    // rules from autoconfig of this process, NULL when the channel is taken by another engine
+    zsock_t*   rules  = RuleChannel::bind(name);
+    zpoller_t* poller = zpoller_new(pipe, mlm_client_msgpipe(client), rules, NULL);
     assert(poller);
 
     uint64_t timeout = 30000;
@@ -819,6 +1203,11 @@ void fty_alert_engine_mailbox(zsock_t* pipe, void* args)
             continue;
         }
 
+        if (rules && which == rules) {
+            add_queued_rules(alertConfiguration);
+            continue;
+        }
+
         // This agent is a reactive agent, it reacts only on messages
         // and doesn't do anything if there is no messages
         // TODO: probably alert also should be send every XXX seconds,
@@ -839,10 +1228,12 @@ void fty_alert_engine_mailbox(zsock_t* pipe, void* args)
             //  * get detailed info about the rule
             //  * new/update rule
             //  * touch rule
+            //  * evaluation statistics
             const char* sender = mlm_client_sender(client);
             char* command = zmsg_popstr(zmessage);
             char* param   = zmsg_popstr(zmessage);
 			log_debug("IN-MAILBOX from %s: subject: %s, cmd: %s, param1: %s", sender, RULES_SUBJECT, command, param);
+            trace_probe2(mailbox_command_begin, command, param);
             if (command && param) {
                 if (streq(command, "LIST")) {
                     char* rule_class = zmsg_popstr(zmessage);
@@ -864,6 +1255,11 @@ void fty_alert_engine_mailbox(zsock_t* pipe, void* args)
                     }
                 } else if (streq(command, "TOUCH")) {
                     touch_rule(client, param, alertConfiguration, true);
+                } else if (streq(command, "STATS")) {
+                    // STATS/sort[/top]
+                    char* top = zmsg_popstr(zmessage);
+                    get_stats(client, param, top, alertConfiguration);
+                    zstr_free(&top);
                 } else if (streq(command, "DELETE")) {
                     log_info("Requested deletion of rule '%s'", param);
                     RuleNameMatcher matcher(param);
@@ -876,6 +1272,7 @@ void fty_alert_engine_mailbox(zsock_t* pipe, void* args)
                     log_error("Received unexpected message to MAILBOX with command '%s'", command);
                 }
             }
+            trace_probe2(mailbox_command_end, command, param);
             zstr_free(&command);
             zstr_free(&param);
         } else {
@@ -889,6 +1286,7 @@ void fty_alert_engine_mailbox(zsock_t* pipe, void* args)
     }
 exit:
     zpoller_destroy(&poller);
+    RuleChannel::unbind(name);
     mlm_client_destroy(&client);
 }
 
@@ -23,9 +23,30 @@
 #include <czmq.h>
 #include <fty_proto.h>
 #include <malamute.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/// Totals of replay_metrics()
+struct ReplayStats
+{
+    uint64_t cycles      = 0; // SHM snapshots
+    uint64_t metrics     = 0;
+    uint64_t evaluations = 0;
+    uint64_t alerts      = 0; // alerts which would have been published
+    uint64_t time        = 0; // wall time of the replay, us
+    bool     truncated   = false;
+};
 
 
 void  fty_alert_engine_stream(zsock_t* pipe, void* args);
 void  fty_alert_engine_mailbox(zsock_t* pipe, void* args);
 void  clearEvaluateMetrics();
+void  publish_self_metrics(uint64_t cycle, size_t metrics, int ttl);
 char* s_readall(const char* filename);
+
+/// Replays metrics recorded by the stream actor (see RECORD) into rules of rules_path
+///
+/// Runs without malamute and as fast as possible, time is simulated from the recording.
+/// @param[in] alerts - where alerts which would have been published are written, one per line, may be NULL
+/// @return 0 on success, -1 when the recording can't be read
+int replay_metrics(const char* recording, const char* rules_path, FILE* alerts, ReplayStats& stats);
@@ -0,0 +1,64 @@
+/*  =========================================================================
+    latencyhistogram - Histogram of latencies in power of two buckets
+
+    Copyright (C) 2014 - 2021 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#include "latencyhistogram.h"
+#include <algorithm>
+#include <cmath>
+
+void LatencyHistogram::add(uint64_t value)
+{
+    int bucket = value ? 64 - __builtin_clzll(value) : 0;
+    _buckets[bucket]++;
+    _count++;
+    _max = std::max(_max, value);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other)
+{
+    for (int i = 0; i < BUCKETS; i++) {
+        _buckets[i] += other._buckets[i];
+    }
+    _count += other._count;
+    _max = std::max(_max, other._max);
+}
+
+uint64_t LatencyHistogram::percentile(double p) const
+{
+    if (_count == 0) {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(std::ceil(static_cast<double>(_count) * p / 100));
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        seen += _buckets[i];
+        if (seen >= rank && seen > 0) {
+            // largest value of bit length i
+            uint64_t bound = (i == 0) ? 0 : (i == 64) ? UINT64_MAX : (uint64_t(1) << i) - 1;
+            return std::min(bound, _max);
+        }
+    }
+    return _max;
+}
+
+void LatencyHistogram::reset()
+{
+    *this = LatencyHistogram();
+}
@@ -0,0 +1,63 @@
+/*  =========================================================================
+    latencyhistogram - Histogram of latencies in power of two buckets
+
+    Copyright (C) 2014 - 2021 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+
+#include <cstdint>
+
+/// Histogram of latencies (or any unsigned values) in power of two buckets
+///
+/// Adding a value is a few instructions, percentiles are precise to a factor of two.
+/// Not thread safe, callers guard it.
+class LatencyHistogram
+{
+public:
+    /// Records value
+    void add(uint64_t value);
+
+    /// Adds all values recorded by other
+    void merge(const LatencyHistogram& other);
+
+    /// Number of recorded values
+    uint64_t count() const
+    {
+        return _count;
+    }
+
+    /// Largest recorded value
+    uint64_t max() const
+    {
+        return _max;
+    }
+
+    /// Upper bound of the p-th percentile (0 < p <= 100), 0 when nothing is recorded
+    uint64_t percentile(double p) const;
+
+    /// Forgets recorded values
+    void reset();
+
+private:
+    static const int BUCKETS = 65; // bucket i holds values of bit length i
+
+    uint64_t _buckets[BUCKETS] = {};
+    uint64_t _count            = 0;
+    uint64_t _max              = 0;
+};
@@ -0,0 +1,145 @@
+/*  =========================================================================
+    logthrottle - Rate limiting of repeated log messages
+
+    Copyright (C) 2014 - 2021 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#include "logthrottle.h"
+#include <algorithm>
+#include <chrono>
+
+// keys are pruned when there are more of them
+#define LOG_THROTTLE_MAX_KEYS 4096
+
+// throttles for flushAll(), function static as throttles are static objects of other units
+static std::mutex& s_throttles_mutex()
+{
+    static std::mutex mtx;
+    return mtx;
+}
+
+static std::vector<LogThrottle*>& s_throttles()
+{
+    static std::vector<LogThrottle*> throttles;
+    return throttles;
+}
+
+static uint64_t s_now()
+{
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+LogThrottle::LogThrottle(uint64_t interval)
+    : _interval(interval)
+{
+    std::lock_guard<std::mutex> lock(s_throttles_mutex());
+    s_throttles().push_back(this);
+}
+
+LogThrottle::~LogThrottle()
+{
+    std::lock_guard<std::mutex> lock(s_throttles_mutex());
+    auto&                       throttles = s_throttles();
+    throttles.erase(std::remove(throttles.begin(), throttles.end(), this), throttles.end());
+}
+
+bool LogThrottle::allow(const std::string& key, uint64_t& occurrences, uint64_t& seconds, const char* what)
+{
+    return allow(key, s_now(), occurrences, seconds, what);
+}
+
+bool LogThrottle::allow(
+    const std::string& key, uint64_t now, uint64_t& occurrences, uint64_t& seconds, const char* what)
+{
+    std::lock_guard<std::mutex> lock(_mtx);
+
+    auto it = _entries.find(key);
+    if (it == _entries.end()) {
+        if (_entries.size() >= LOG_THROTTLE_MAX_KEYS) {
+            // forget keys which would be let through anyway
+            for (auto entry = _entries.begin(); entry != _entries.end();) {
+                if (now - entry->second.logged >= _interval) {
+                    entry = _entries.erase(entry);
+                } else {
+                    ++entry;
+                }
+            }
+        }
+        _entries.emplace(key, Entry{now, 0, what});
+        occurrences = 1;
+        seconds     = 0;
+        return true;
+    }
+
+    Entry& entry = it->second;
+    entry.what   = what;
+    if (now - entry.logged < _interval) {
+        entry.suppressed++;
+        return false;
+    }
+    occurrences      = entry.suppressed + 1;
+    seconds          = (now - entry.logged) / 1000;
+    entry.logged     = now;
+    entry.suppressed = 0;
+    return true;
+}
+
+size_t LogThrottle::flush()
+{
+    return flush(s_now());
+}
+
+size_t LogThrottle::flush(uint64_t now)
+{
+    std::lock_guard<std::mutex> lock(_mtx);
+
+    size_t logged = 0;
+    for (auto it = _entries.begin(); it != _entries.end();) {
+        Entry& entry = it->second;
+        if (now - entry.logged < _interval) {
+            ++it;
+        } else if (entry.suppressed == 0) {
+            // next message would be let through anyway
+            it = _entries.erase(it);
+        } else {
+            log_error("%s: %" PRIu64 " more occurrences of '%s' in last %" PRIu64 " seconds", it->first.c_str(),
+                entry.suppressed, entry.what ? entry.what : "message", (now - entry.logged) / 1000);
+            entry.logged     = now;
+            entry.suppressed = 0;
+            logged++;
+            ++it;
+        }
+    }
+    return logged;
+}
+
+void LogThrottle::flushAll()
+{
+    std::lock_guard<std::mutex> lock(s_throttles_mutex());
+    for (LogThrottle* throttle : s_throttles()) {
+        throttle->flush();
+    }
+}
+
+size_t LogThrottle::size() const
+{
+    std::lock_guard<std::mutex> lock(_mtx);
+    return _entries.size();
+}
@@ -0,0 +1,91 @@
+/*  =========================================================================
+    logthrottle - Rate limiting of repeated log messages
+
+    Copyright (C) 2014 - 2021 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+
+#include <cinttypes>
+#include <cstdint>
+#include <fty_log.h>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/// Lets a message of the same key through once per interval and counts the others
+///
+/// A device sending bad metrics or a broken rule produces the same error every polling cycle,
+/// the throttle turns it into one line per interval with the number of occurrences.
+/// Occurrences of a message which does not come again are logged by flush().
+class LogThrottle
+{
+public:
+    /// @param[in] interval - minimal time between two messages of the same key, in ms
+    explicit LogThrottle(uint64_t interval = 300000);
+    ~LogThrottle();
+
+    /// Message of key occurred
+    /// @param[out] occurrences - occurrences since the previous message of key was let through, including this one
+    /// @param[out] seconds - time since the previous message of key was let through
+    /// @param[in] what - message format for the summary of flush(), string literal
+    /// @return true when the message should be logged
+    bool allow(const std::string& key, uint64_t& occurrences, uint64_t& seconds, const char* what = nullptr);
+    /// Same as above, now is the current time in ms
+    bool allow(
+        const std::string& key, uint64_t now, uint64_t& occurrences, uint64_t& seconds, const char* what = nullptr);
+
+    /// Logs the number of suppressed occurrences of keys whose interval has passed since they were let through,
+    /// and forgets keys with no occurrence since then
+    /// @return number of summaries logged
+    size_t flush();
+    /// Same as above, now is the current time in ms
+    size_t flush(uint64_t now);
+    /// flush() of all throttles, call it once per polling cycle
+    static void flushAll();
+
+    /// Number of tracked keys
+    size_t size() const;
+
+private:
+    struct Entry
+    {
+        uint64_t    logged;     // time the message was let through
+        uint64_t    suppressed; // occurrences not logged since then
+        const char* what;       // allow()
+    };
+
+    uint64_t                               _interval;
+    mutable std::mutex                     _mtx;
+    std::unordered_map<std::string, Entry> _entries; // key | state
+};
+
+/// log_error limited by throttle per key, repeated messages end with "(N occurrences in last M seconds)"
+#define log_error_throttled(throttle, key, fmt, ...)                                                                   \
+    do {                                                                                                               \
+        uint64_t log_throttle_occurrences, log_throttle_seconds;                                                       \
+        if ((throttle).allow((key), log_throttle_occurrences, log_throttle_seconds, fmt)) {                            \
+            if (log_throttle_occurrences > 1) {                                                                        \
+                log_error(fmt " (%" PRIu64 " occurrences in last %" PRIu64 " seconds)", __VA_ARGS__,                   \
+                    log_throttle_occurrences, log_throttle_seconds);                                                   \
+            } else {                                                                                                   \
+                log_error(fmt, __VA_ARGS__);                                                                           \
+            }                                                                                                          \
+        }                                                                                                              \
+    } while (0)
@@ -17,7 +17,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 */
 
 #include "luarule.h"
+#include "debuglog.h"
 #include "fty_alert_engine_audit_log.h"
+#include "logthrottle.h"
+#include "probes.h"
 #include <algorithm>
 #include <czmq.h>
 #include <fty_log.h>
@@ -28,6 +31,8 @@ LuaRule::~LuaRule()
 {
     if (_lstate)
         lua_close(_lstate);
+    if (_auditId >= 0)
+        AuditLogManager::releaseRule(static_cast<uint32_t>(_auditId));
 }
 
 LuaRule::LuaRule(const LuaRule& r)
@@ -81,31 +86,28 @@ void LuaRule::code(const std::string& newCode)
     }
 }
 
+// rules returning unexpected results every polling cycle
+static LogThrottle evaluateErrors;
+
 int LuaRule::evaluate(const MetricList& metricList, PureAlert& pureAlert)
 {
-    log_debug("LuaRule::evaluate %s", _name.c_str());
+    log_debug_hot("LuaRule::evaluate %s", _name.c_str());
     int res = 0;
 
-    std::vector<double>      values;
-    std::vector<std::string> auditValues;
-    int                      index = 0;
+    std::vector<double> values;
+    int                 index = 0;
     for (const auto& metric : _metrics) {
         double value = metricList.find(metric);
         if (std::isnan(value)) {
-            log_debug("metric#%d: %s = NaN", index, metric.c_str());
-            log_debug("Don't have everything for '%s' yet", _name.c_str());
-            std::stringstream ss;
-            ss << metric.c_str() << " = "
-               << "NaN";
-            auditValues.push_back(ss.str());
+            log_debug_hot("metric#%d: %s = NaN", index, metric.c_str());
+            log_debug_hot("Don't have everything for '%s' yet", _name.c_str());
+            values.push_back(value); // for audit only
+            _stats.skipped++;
             res = RULE_RESULT_UNKNOWN;
             break;
         }
         values.push_back(value);
-        log_debug("metric#%d: %s = %lf", index, metric.c_str(), value);
-        std::stringstream ss;
-        ss << metric.c_str() << " = " << value;
-        auditValues.push_back(ss.str());
+        log_debug_hot("metric#%d: %s = %lf", index, metric.c_str(), value);
         index++;
     }
 
@@ -116,35 +118,32 @@ int LuaRule::evaluate(const MetricList& metricList, PureAlert& pureAlert)
 
         auto outcome = _outcomes.find(statusText);
         if (outcome != _outcomes.cend()) {
-            log_debug("LuaRule::evaluate %s START %s", _name.c_str(), outcome->second._severity.c_str());
+            log_debug_hot("LuaRule::evaluate %s START %s", _name.c_str(), outcome->second._severity.c_str());
 
             // some known outcome was found
-            pureAlert = PureAlert(ALERT_START, static_cast<uint64_t>(::time(NULL)), outcome->second._description,
-                _element, outcome->second._severity, outcome->second._actions);
-            pureAlert.print();
+            pureAlert = PureAlert(ALERT_START, metricList.time(), outcome->second._description, _element,
+                outcome->second._severity, outcome->second._actions);
+            if (log_debug_enabled())
+                pureAlert.print();
         } else if (status == RULE_RESULT_OK) {
-            log_debug("LuaRule::evaluate %s %s", _name.c_str(), "RESOLVED");
+            log_debug_hot("LuaRule::evaluate %s %s", _name.c_str(), "RESOLVED");
 
             // When alert is resolved, it doesn't have new severity!!!!
-            pureAlert = PureAlert(
-                ALERT_RESOLVED, static_cast<uint64_t>(::time(NULL)), "everything is ok", _element, "OK", {""});
-            pureAlert.print();
+            pureAlert = PureAlert(ALERT_RESOLVED, metricList.time(), "everything is ok", _element, "OK", {""});
+            if (log_debug_enabled())
+                pureAlert.print();
         } else {
-            log_error(
+            log_error_throttled(evaluateErrors, _name,
                 "LuaRule::evaluate %s has returned a result %s, but it is not specified in 'result' in the JSON rule "
                 "definition",
                 _name.c_str(), statusText);
             res = RULE_RESULT_UNKNOWN;
         }
     }
-    std::stringstream ss;
-    std::for_each(begin(auditValues), end(auditValues), [&ss](const std::string& elem) {
-        if (ss.str().empty())
-            ss << elem;
-        else
-            ss << ", " << elem;
-    });
-    log_info_alarms_engine_audit("Evaluate rule '%s' [%s] -> %s %s", _name.c_str(), ss.str().c_str(),
+    if (_auditId < 0) {
+        _auditId = AuditLogManager::ruleId(_name, _metrics);
+    }
+    AuditLogManager::audit(static_cast<uint32_t>(_auditId), values,
         (res == RULE_RESULT_UNKNOWN) ? ALERT_UNKNOWN : pureAlert._status.c_str(),
         (res == RULE_RESULT_UNKNOWN) ? "" : pureAlert._severity.c_str());
     return res;
@@ -163,7 +162,10 @@ double LuaRule::luaEvaluate(const std::vector<double>& metrics)
     for (const auto x : metrics) {
         lua_pushnumber(_lstate, x);
     }
-    if (lua_pcall(_lstate, static_cast<int>(metrics.size()), 1, 0) != 0) {
+    trace_probe1(lua_call_start, _name.c_str());
+    int status = lua_pcall(_lstate, static_cast<int>(metrics.size()), 1, 0);
+    trace_probe2(lua_call_end, _name.c_str(), status);
+    if (status != 0) {
         throw std::runtime_error("LUA calling main() failed!");
     }
     if (!lua_isnumber(_lstate, -1)) {
@@ -174,6 +176,14 @@ double LuaRule::luaEvaluate(const std::vector<double>& metrics)
     return result;
 }
 
+size_t LuaRule::luaMemory() const
+{
+    if (_lstate == NULL)
+        return 0;
+    return static_cast<size_t>(lua_gc(_lstate, LUA_GCCOUNT, 0)) * 1024 +
+           static_cast<size_t>(lua_gc(_lstate, LUA_GCCOUNTB, 0));
+}
+
 void LuaRule::_setGlobalVariablesToLUA()
 {
     if (_lstate == NULL)
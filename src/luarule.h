@@ -42,6 +42,8 @@ public:
     void   globalVariables(const std::map<std::string, double>& vars);
     int    evaluate(const MetricList& metricList, PureAlert& pureAlert);
     double luaEvaluate(const std::vector<double>& metrics);
+    /// Memory used by the Lua state, in bytes
+    size_t luaMemory() const;
     ~LuaRule();
 
 protected:
@@ -52,4 +54,5 @@ protected:
 
 private:
     std::string _code;
+    int64_t     _auditId = -1; // AuditLogManager::ruleId(), set by the first evaluation, released by destructor
 };
@@ -20,6 +20,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 /// @author Alena Chernikava <AlenaChernikava@Eaton.com>
 /// @brief Very simple class to store information about one metric
 #pragma once
+#include "clock.h"
 #include <string>
 
 class MetricInfo
@@ -85,7 +86,7 @@ public:
     };
     void setTime(void)
     {
-        _timestamp = static_cast<uint64_t>(::time(NULL));
+        _timestamp = Clock::time();
     };
     void setUnits(const std::string& U)
     {
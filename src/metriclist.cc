@@ -42,7 +42,7 @@ double MetricList::findAndCheck(const std::string& topic) const
     if (it == _knownMetrics.cend()) {
         return std::nan("");
     } else {
-        uint64_t currentTimestamp = static_cast<uint64_t>(::time(NULL));
+        uint64_t currentTimestamp = time();
         if ((currentTimestamp - it->second._timestamp) > it->second._ttl) {
             return std::nan("");
         } else {
@@ -76,7 +76,7 @@ MetricInfo MetricList::getMetricInfo(const std::string& topic) const
 
 void MetricList::removeOldMetrics()
 {
-    uint64_t currentTimestamp = static_cast<uint64_t>(::time(NULL));
+    uint64_t currentTimestamp = time();
 
     for (std::map<std::string, MetricInfo>::iterator iter = _knownMetrics.begin(); iter != _knownMetrics.end();
         /* empty */) {
@@ -21,6 +21,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 /// @brief This class is intended to handle set of current known metrics
 #pragma once
 
+#include "clock.h"
 #include "metricinfo.h"
 #include <map>
 #include <string>
@@ -67,9 +68,25 @@ public:
     ///                            ( isUnknown() is true)
     MetricInfo getMetricInfo(const std::string& topic) const;
 
-    /// Removes old metrics from the list
+    /// Removes metrics expired at time()
     void removeOldMetrics(void);
 
+    /// Sets time of the current processing cycle
+    ///
+    /// Expiration of metrics and times of alerts use it until the next call, so that the clock
+    /// is read once per cycle rather than per metric.
+    /// @param[in] now - time, s (see Clock::time())
+    void setTime(uint64_t now)
+    {
+        _now = now;
+    }
+
+    /// Time of the current processing cycle, s, the current time when none was set
+    uint64_t time(void) const
+    {
+        return _now ? _now : Clock::time();
+    }
+
     /// Gets the last added metric
     ///
     /// @return last added (or updated) metric
@@ -84,4 +101,7 @@ private:
 
     /// Keep track of last inserted metric
     MetricInfo _lastInsertedMetric;
+
+    /// Time of the current processing cycle, 0 when not set
+    uint64_t _now = 0;
 };
@@ -0,0 +1,343 @@
+/*  =========================================================================
+    metricrecording - Recording of metrics seen by the engine, for replay
+
+    Copyright (C) 2014 - 2021 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#include "metricrecording.h"
+#include <cerrno>
+#include <cinttypes>
+#include <cstring>
+#include <fty_log.h>
+
+static const char   RECORDING_MAGIC[] = "FTYAER01";
+static const size_t MAGIC_SIZE        = 8;
+
+// Record: u32 payload size | u32 payload checksum | payload (integers in host byte order)
+// Payload: u8 kind | svarint time - time of the previous record (ms) | ...
+//   SNAPSHOT:    varint count | (name type | name asset | str value | name unit | varint ttl | varint time)...
+//   UNAVAILABLE: str topic
+// name is varint index of the name, followed by str when the name is new (index == count of names so far)
+// str is varint size | bytes, varint is LEB128, svarint is zigzag encoded varint
+
+static uint32_t s_checksum(const char* data, size_t size)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= static_cast<uint8_t>(data[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void s_put_varint(std::string& buf, uint64_t value)
+{
+    while (value >= 0x80) {
+        buf.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    buf.push_back(static_cast<char>(value));
+}
+
+static void s_put_svarint(std::string& buf, int64_t value)
+{
+    s_put_varint(buf, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+static void s_put_str(std::string& buf, const std::string& str)
+{
+    s_put_varint(buf, str.size());
+    buf.append(str);
+}
+
+// sequential reader over a payload, every get fails once the payload is exhausted
+class PayloadReader
+{
+public:
+    PayloadReader(const char* data, size_t size)
+        : _data(data)
+        , _size(size)
+    {
+    }
+
+    bool get(uint8_t& value)
+    {
+        if (_pos >= _size) {
+            return false;
+        }
+        value = static_cast<uint8_t>(_data[_pos++]);
+        return true;
+    }
+
+    bool getVarint(uint64_t& value)
+    {
+        value = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            uint8_t byte;
+            if (!get(byte)) {
+                return false;
+            }
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool getSvarint(int64_t& value)
+    {
+        uint64_t raw;
+        if (!getVarint(raw)) {
+            return false;
+        }
+        value = static_cast<int64_t>(raw >> 1) ^ -static_cast<int64_t>(raw & 1);
+        return true;
+    }
+
+    bool get(std::string& str)
+    {
+        uint64_t size;
+        if (!getVarint(size) || _size - _pos < size) {
+            return false;
+        }
+        str.assign(_data + _pos, size);
+        _pos += size;
+        return true;
+    }
+
+    bool end() const
+    {
+        return _pos == _size;
+    }
+
+private:
+    const char* _data;
+    size_t      _size;
+    size_t      _pos = 0;
+};
+
+fty_proto_t* RecordedMetric::toProto() const
+{
+    fty_proto_t* metric = fty_proto_new(FTY_PROTO_METRIC);
+    fty_proto_set_type(metric, "%s", type.c_str());
+    fty_proto_set_name(metric, "%s", name.c_str());
+    fty_proto_set_value(metric, "%s", value.c_str());
+    fty_proto_set_unit(metric, "%s", unit.c_str());
+    fty_proto_set_ttl(metric, ttl);
+    if (time) {
+        fty_proto_aux_insert(metric, "time", "%" PRIu64, time);
+    }
+    return metric;
+}
+
+int MetricRecorder::open(const std::string& file)
+{
+    close();
+    _file.open(file, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!_file) {
+        log_error("can't create metric recording %s (%s)", file.c_str(), strerror(errno));
+        return -1;
+    }
+    _file.write(RECORDING_MAGIC, MAGIC_SIZE);
+    _file.flush();
+    if (!_file) {
+        log_error("can't write metric recording %s", file.c_str());
+        close();
+        return -1;
+    }
+    log_info("recording metrics to %s", file.c_str());
+    return 0;
+}
+
+void MetricRecorder::close()
+{
+    if (_file.is_open()) {
+        _file.close();
+    }
+    _file.clear();
+    _names.clear();
+    _time = 0;
+}
+
+void MetricRecorder::putName(std::string& buf, const std::string& name)
+{
+    auto it = _names.find(name);
+    if (it != _names.end()) {
+        s_put_varint(buf, it->second);
+        return;
+    }
+    size_t index = _names.size();
+    _names.emplace(name, index);
+    s_put_varint(buf, index);
+    s_put_str(buf, name);
+}
+
+int MetricRecorder::snapshot(int64_t time, fty::shm::shmMetrics& metrics)
+{
+    if (!isOpen()) {
+        return -1;
+    }
+
+    std::string payload;
+    payload.push_back(MetricRecord::SNAPSHOT);
+    s_put_svarint(payload, time - _time);
+    s_put_varint(payload, static_cast<uint64_t>(metrics.size()));
+    for (auto& metric : metrics) {
+        putName(payload, fty_proto_type(metric));
+        putName(payload, fty_proto_name(metric));
+        s_put_str(payload, fty_proto_value(metric));
+        putName(payload, fty_proto_unit(metric));
+        s_put_varint(payload, fty_proto_ttl(metric));
+        s_put_varint(payload, fty_proto_aux_number(metric, "time", 0));
+    }
+    _time = time;
+    return write(payload);
+}
+
+int MetricRecorder::unavailable(int64_t time, const std::string& topic)
+{
+    if (!isOpen()) {
+        return -1;
+    }
+
+    std::string payload;
+    payload.push_back(MetricRecord::UNAVAILABLE);
+    s_put_svarint(payload, time - _time);
+    s_put_str(payload, topic);
+    _time = time;
+    return write(payload);
+}
+
+int MetricRecorder::write(const std::string& payload)
+{
+    uint32_t size     = static_cast<uint32_t>(payload.size());
+    uint32_t checksum = s_checksum(payload.data(), payload.size());
+    _file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    _file.write(reinterpret_cast<const char*>(&checksum), sizeof(checksum));
+    _file.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+    // the recording is complete up to the last record even when the engine is killed
+    _file.flush();
+    if (!_file) {
+        log_error("can't write metric recording, recording stopped");
+        close();
+        return -1;
+    }
+    return 0;
+}
+
+int MetricRecording::open(const std::string& file)
+{
+    std::ifstream f(file, std::ios::in | std::ios::binary);
+    if (!f) {
+        log_error("can't open metric recording %s (%s)", file.c_str(), strerror(errno));
+        return -1;
+    }
+    _buf.assign((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    if (f.bad() || _buf.size() < MAGIC_SIZE || _buf.compare(0, MAGIC_SIZE, RECORDING_MAGIC) != 0) {
+        log_error("%s is not a metric recording", file.c_str());
+        _buf.clear();
+        return -1;
+    }
+    _pos       = MAGIC_SIZE;
+    _time      = 0;
+    _truncated = false;
+    _names.clear();
+    return 0;
+}
+
+bool MetricRecording::next(MetricRecord& record)
+{
+    uint32_t size, checksum;
+    if (_pos >= _buf.size() || _truncated) {
+        return false;
+    }
+    if (_buf.size() - _pos < sizeof(size) + sizeof(checksum)) {
+        _truncated = true;
+        return false;
+    }
+    memcpy(&size, _buf.data() + _pos, sizeof(size));
+    memcpy(&checksum, _buf.data() + _pos + sizeof(size), sizeof(checksum));
+    const char* payload = _buf.data() + _pos + sizeof(size) + sizeof(checksum);
+    if (_buf.size() - _pos - sizeof(size) - sizeof(checksum) < size || s_checksum(payload, size) != checksum ||
+        !parse(payload, size, record)) {
+        _truncated = true;
+        return false;
+    }
+    _pos += sizeof(size) + sizeof(checksum) + size;
+    return true;
+}
+
+bool MetricRecording::parse(const char* data, size_t size, MetricRecord& record)
+{
+    PayloadReader reader(data, size);
+
+    auto getName = [this, &reader](std::string& name) {
+        uint64_t index;
+        if (!reader.getVarint(index) || index > _names.size()) {
+            return false;
+        }
+        if (index == _names.size()) {
+            if (!reader.get(name)) {
+                return false;
+            }
+            _names.push_back(name);
+        } else {
+            name = _names[index];
+        }
+        return true;
+    };
+
+    uint8_t kind;
+    int64_t delta;
+    if (!reader.get(kind) || !reader.getSvarint(delta)) {
+        return false;
+    }
+    record.kind = static_cast<MetricRecord::Kind>(kind);
+    record.time = _time + delta;
+    record.metrics.clear();
+    record.topic.clear();
+
+    if (kind == MetricRecord::SNAPSHOT) {
+        uint64_t count;
+        if (!reader.getVarint(count)) {
+            return false;
+        }
+        for (uint64_t i = 0; i < count; i++) {
+            RecordedMetric metric;
+            uint64_t       ttl;
+            if (!getName(metric.type) || !getName(metric.name) || !reader.get(metric.value) ||
+                !getName(metric.unit) || !reader.getVarint(ttl) || !reader.getVarint(metric.time)) {
+                return false;
+            }
+            metric.ttl = static_cast<uint32_t>(ttl);
+            record.metrics.push_back(std::move(metric));
+        }
+    } else if (kind == MetricRecord::UNAVAILABLE) {
+        if (!reader.get(record.topic)) {
+            return false;
+        }
+    } else {
+        return false;
+    }
+    if (!reader.end()) {
+        return false;
+    }
+    _time = record.time;
+    return true;
+}
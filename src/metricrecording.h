@@ -0,0 +1,129 @@
+/*  =========================================================================
+    metricrecording - Recording of metrics seen by the engine, for replay
+
+    Copyright (C) 2014 - 2021 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <fty_proto.h>
+#include <fty_shm.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/// Metric of a recorded SHM snapshot
+struct RecordedMetric
+{
+    std::string type;     // metric name (e.g. load.default)
+    std::string name;     // asset name
+    std::string value;
+    std::string unit;
+    uint32_t    ttl  = 0;
+    uint64_t    time = 0; // "time" aux of the metric, 0 when it has none
+
+    /// Metric as read from SHM, caller owns it
+    fty_proto_t* toProto() const;
+};
+
+/// What the stream actor processed at one time
+struct MetricRecord
+{
+    enum Kind
+    {
+        SNAPSHOT    = 'S', // metrics read from SHM in a polling cycle
+        UNAVAILABLE = 'U'  // METRICUNAVAILABLE stream message
+    };
+
+    Kind                        kind = SNAPSHOT;
+    int64_t                     time = 0; // wall clock time, ms
+    std::vector<RecordedMetric> metrics;  // SNAPSHOT
+    std::string                 topic;    // UNAVAILABLE
+};
+
+/// Writes metric records to a file
+///
+/// Asset, metric and unit names are written once and referenced by index afterwards, so a
+/// snapshot costs little more than the values. Records are framed and checksummed as in
+/// StateJournal; a torn record at the end (crash while recording) ends the replay.
+class MetricRecorder
+{
+public:
+    MetricRecorder() = default;
+    MetricRecorder(const MetricRecorder&) = delete;
+    MetricRecorder& operator=(const MetricRecorder&) = delete;
+
+    /// Starts a new recording, any previous one is closed
+    /// @return 0 on success, -1 when the file can't be created
+    int open(const std::string& file);
+
+    /// Ends the recording
+    void close();
+
+    /// Recording is in progress
+    bool isOpen() const
+    {
+        return _file.is_open();
+    }
+
+    /// Records metrics read from SHM
+    /// @return 0 on success, -1 on error (the recording is closed)
+    int snapshot(int64_t time, fty::shm::shmMetrics& metrics);
+
+    /// Records METRICUNAVAILABLE stream message
+    /// @return 0 on success, -1 on error (the recording is closed)
+    int unavailable(int64_t time, const std::string& topic);
+
+private:
+    void putName(std::string& buf, const std::string& name);
+    int  write(const std::string& payload);
+
+    std::ofstream                           _file;
+    std::unordered_map<std::string, size_t> _names; // name | index in the order of the first use
+    int64_t                                 _time = 0;
+};
+
+/// Reads records written by MetricRecorder, in the recorded order
+class MetricRecording
+{
+public:
+    /// Opens recording
+    /// @return 0 on success, -1 when the file can't be read or is not a recording
+    int open(const std::string& file);
+
+    /// Reads the next record
+    /// @return false at the end of the recording
+    bool next(MetricRecord& record);
+
+    /// Recording ends with an incomplete or damaged record
+    bool truncated() const
+    {
+        return _truncated;
+    }
+
+private:
+    bool parse(const char* data, size_t size, MetricRecord& record);
+
+    std::string              _buf;
+    size_t                   _pos = 0;
+    std::vector<std::string> _names;
+    int64_t                  _time      = 0;
+    bool                     _truncated = false;
+};
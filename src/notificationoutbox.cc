@@ -0,0 +1,193 @@
+/*
+Copyright (C) 2014 - 2021 Eaton
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "notificationoutbox.h"
+#include "probes.h"
+#include <fty_log.h>
+
+NotificationOutbox::NotificationOutbox(SendFn send, uint64_t replyTimeout, uint64_t coalesceWindow,
+    uint64_t retryBackoff, unsigned maxAttempts, size_t maxInFlight)
+    : _send(send)
+    , _replyTimeout(replyTimeout)
+    , _coalesceWindow(coalesceWindow)
+    , _retryBackoff(retryBackoff)
+    , _maxAttempts(maxAttempts)
+    , _maxInFlight(maxInFlight)
+{
+}
+
+NotificationOutbox::~NotificationOutbox()
+{
+    if (!_queue.empty() || !_inFlight.empty()) {
+        log_warning("dropping %zu queued and %zu unanswered notifications", _queue.size(), _inFlight.size());
+    }
+    for (auto& notification : _queue) {
+        zmsg_destroy(&notification.msg);
+    }
+    for (auto& it : _inFlight) {
+        zmsg_destroy(&it.second.msg);
+    }
+}
+
+NotificationOutbox::Queue::iterator NotificationOutbox::insert(Notification&& notification)
+{
+    // due times of the new notifications mostly grow, search from the back
+    auto pos = _queue.end();
+    while (pos != _queue.begin() && std::prev(pos)->due > notification.due) {
+        --pos;
+    }
+    auto it           = _queue.insert(pos, std::move(notification));
+    _queued[it->key] = it;
+    return it;
+}
+
+NotificationOutbox::Notification NotificationOutbox::take(Queue::iterator it)
+{
+    Notification notification = std::move(*it);
+    _queue.erase(it);
+    _queued.erase(notification.key);
+    return notification;
+}
+
+void NotificationOutbox::enqueue(const std::string& address, const std::string& subject, const std::string& key,
+    zmsg_t** msg_p, uint64_t now)
+{
+    auto it = _queued.find(key);
+    if (it != _queued.end()) {
+        // not sent yet, newer notification supersedes it
+        log_debug("coalescing %s notification '%s'", subject.c_str(), key.c_str());
+        Notification& queued = *it->second;
+        zmsg_destroy(&queued.msg);
+        queued.msg      = *msg_p;
+        queued.attempts = 0;
+        *msg_p          = NULL;
+        return;
+    }
+
+    Notification notification;
+    notification.address = address;
+    notification.subject = subject;
+    notification.key     = key;
+    notification.msg     = *msg_p;
+    notification.due     = now + _coalesceWindow;
+    *msg_p               = NULL;
+    insert(std::move(notification));
+}
+
+void NotificationOutbox::send(Notification&& notification, uint64_t now)
+{
+    notification.attempts++;
+    zuuid_t*    zuuid = zuuid_new();
+    std::string uuid  = zuuid_str_canonical(zuuid);
+    zuuid_destroy(&zuuid);
+
+    zmsg_t* request = zmsg_dup(notification.msg);
+    zmsg_pushstr(request, uuid.c_str());
+    log_debug("sending %s to %s (attempt %u)", notification.subject.c_str(), notification.address.c_str(),
+        notification.attempts);
+    trace_probe4(notification_dispatch, notification.subject.c_str(), notification.address.c_str(),
+        notification.key.c_str(), notification.attempts);
+    if (_send(notification.address, notification.subject, &request) != 0) {
+        zmsg_destroy(&request);
+        retry(notification, now);
+        return;
+    }
+    notification.due = now + _replyTimeout;
+    _inFlight.emplace(uuid, std::move(notification));
+}
+
+void NotificationOutbox::dispatch(uint64_t now)
+{
+    while (!_queue.empty() && _inFlight.size() < _maxInFlight && _queue.front().due <= now) {
+        send(take(_queue.begin()), now);
+    }
+}
+
+bool NotificationOutbox::handleReply(const std::string& uuid, zmsg_t** reply_p, uint64_t /* now */)
+{
+    auto it = _inFlight.find(uuid);
+    if (it == _inFlight.end()) {
+        return false;
+    }
+    Notification notification = std::move(it->second);
+    _inFlight.erase(it);
+
+    char* cmd = zmsg_popstr(*reply_p);
+    if (cmd && streq(cmd, "OK")) {
+        log_debug("%s successful", notification.subject.c_str());
+    } else {
+        // recipient refused the request, repeating it would not help
+        char* cause = zmsg_popstr(*reply_p);
+        log_error("%s failed due to %s", notification.subject.c_str(), cause);
+        zstr_free(&cause);
+    }
+    zstr_free(&cmd);
+    zmsg_destroy(reply_p);
+    zmsg_destroy(&notification.msg);
+    return true;
+}
+
+void NotificationOutbox::checkTimeouts(uint64_t now)
+{
+    for (auto it = _inFlight.begin(); it != _inFlight.end();) {
+        if (it->second.due <= now) {
+            // the request may still be processed, recipient would send the notification twice
+            log_warning("received no reply on %s message in time, not sending it again", it->second.subject.c_str());
+            zmsg_destroy(&it->second.msg);
+            it = _inFlight.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void NotificationOutbox::retry(Notification& notification, uint64_t now)
+{
+    if (notification.attempts >= _maxAttempts) {
+        log_error("cannot send %s message, giving up after %u attempts", notification.subject.c_str(),
+            notification.attempts);
+        zmsg_destroy(&notification.msg);
+        return;
+    }
+    if (_queued.count(notification.key) != 0) {
+        // newer notification is already waiting
+        zmsg_destroy(&notification.msg);
+        return;
+    }
+    log_warning("cannot send %s message, will retry", notification.subject.c_str());
+    notification.due = now + (_retryBackoff << (notification.attempts - 1));
+    insert(std::move(notification));
+}
+
+int64_t NotificationOutbox::timeToNext(uint64_t now) const
+{
+    int64_t next = -1;
+    auto    soonest = [&next, now](uint64_t due) {
+        int64_t left = (due > now) ? static_cast<int64_t>(due - now) : 0;
+        if (next < 0 || left < next) {
+            next = left;
+        }
+    };
+    if (!_queue.empty() && _inFlight.size() < _maxInFlight) {
+        soonest(_queue.front().due);
+    }
+    for (const auto& it : _inFlight) {
+        soonest(it.second.due);
+    }
+    return next;
+}
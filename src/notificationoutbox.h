@@ -0,0 +1,121 @@
+/*
+Copyright (C) 2014 - 2021 Eaton
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/// @file notificationoutbox.h
+/// @brief Outbox of notification requests (e-mail, SMS, GPO) sent by fty-alert-actions
+#pragma once
+
+#include <czmq.h>
+#include <functional>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+/// Outbox of notification requests sent to other agents through malamute mailbox
+///
+/// Notifications are queued and dispatched without waiting for the replies, many requests can be in flight.
+/// Every request gets a correlation id as the first frame, replies are matched by it. Requests which can't be
+/// sent are retried with exponential backoff. Requests which were sent are never sent again: recipients don't
+/// detect duplicates, so a request without reply in time (e.g. slow SMTP server) is only forgotten, and a
+/// refused one is not retried.
+///
+/// Queued notification is held for coalesce window before dispatch. Notification with the same key enqueued
+/// meanwhile replaces the queued one, so only the latest state of an alert reaches a recipient.
+class NotificationOutbox
+{
+public:
+    /// Sends message to address with subject, takes ownership of the message, returns 0 on success
+    typedef std::function<int(const std::string& address, const std::string& subject, zmsg_t** msg_p)> SendFn;
+
+    /// @param[in] send - function sending the request
+    /// @param[in] replyTimeout - [ms] time to wait for a reply before the request is forgotten
+    /// @param[in] coalesceWindow - [ms] time a notification waits in the queue for newer one with the same key
+    /// @param[in] retryBackoff - [ms] delay before the first retry, doubled with every other one
+    /// @param[in] maxAttempts - number of attempts to send before notification is dropped
+    /// @param[in] maxInFlight - maximum number of requests waiting for reply
+    NotificationOutbox(SendFn send, uint64_t replyTimeout, uint64_t coalesceWindow, uint64_t retryBackoff,
+        unsigned maxAttempts, size_t maxInFlight);
+    ~NotificationOutbox();
+
+    NotificationOutbox(const NotificationOutbox&) = delete;
+    NotificationOutbox& operator=(const NotificationOutbox&) = delete;
+
+    /// Queues a notification
+    ///
+    /// @param[in] address - mailbox address of the recipient agent
+    /// @param[in] subject - subject of the request
+    /// @param[in] key - notifications with the same key are coalesced
+    /// @param[in] msg_p - request without correlation id, outbox takes ownership
+    /// @param[in] now - [ms] current monotonic time
+    void enqueue(const std::string& address, const std::string& subject, const std::string& key, zmsg_t** msg_p,
+        uint64_t now);
+
+    /// Sends queued notifications which are due, while in flight limit allows it
+    void dispatch(uint64_t now);
+
+    /// Handles a reply
+    ///
+    /// @param[in] uuid - correlation id of the reply
+    /// @param[in] reply_p - rest of the reply ("OK" or "ERROR"/cause), destroyed if the reply is known
+    /// @return false if uuid doesn't belong to any request in flight
+    bool handleReply(const std::string& uuid, zmsg_t** reply_p, uint64_t now);
+
+    /// Forgets requests which didn't get reply in time
+    void checkTimeouts(uint64_t now);
+
+    /// @return [ms] time to the next due notification or reply timeout, -1 if there is nothing to wait for
+    int64_t timeToNext(uint64_t now) const;
+
+    size_t queued() const
+    {
+        return _queue.size();
+    }
+    size_t inFlight() const
+    {
+        return _inFlight.size();
+    }
+
+private:
+    struct Notification
+    {
+        std::string address;
+        std::string subject;
+        std::string key;
+        zmsg_t*     msg      = NULL; // request without correlation id
+        unsigned    attempts = 0;
+        uint64_t    due      = 0; // [ms] not sent before / reply expected until
+    };
+    typedef std::list<Notification> Queue;
+
+    Queue::iterator insert(Notification&& notification);
+    Notification    take(Queue::iterator it);
+    void            send(Notification&& notification, uint64_t now);
+    void            retry(Notification& notification, uint64_t now);
+
+    SendFn   _send;
+    uint64_t _replyTimeout;
+    uint64_t _coalesceWindow;
+    uint64_t _retryBackoff;
+    unsigned _maxAttempts;
+    size_t   _maxInFlight;
+
+    /// Queue ordered by due time, coalesced notifications keep their position
+    Queue                                                         _queue;
+    std::unordered_map<std::string, Queue::iterator>              _queued;   // key | queued notification
+    std::unordered_map<std::string, Notification>                 _inFlight; // correlation id | notification
+};
@@ -0,0 +1,57 @@
+/*  =========================================================================
+    probes - Static tracepoints (USDT) on the engine hot paths
+
+    Copyright (C) 2014 - 2021 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+
+/// Probes of provider fty_alert_engine, see src/bpftrace/ for their list and example scripts
+///
+/// A probe is a single nop in the code and a note in the ELF binary. Tracers (bpftrace, perf,
+/// systemtap) attach to it in a running engine, with no restart and no cost until they do.
+/// Arguments are evaluated even when nobody traces, so only cheap values are passed.
+/// Probes are compiled in when <sys/sdt.h> (systemtap-sdt-dev) is available, unless built with
+/// FTY_ALERT_ENGINE_NO_PROBES. FTY_ALERT_ENGINE_PROBES is defined when they are.
+#if !defined(FTY_ALERT_ENGINE_NO_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define FTY_ALERT_ENGINE_PROBES 1
+#endif
+#endif
+
+#ifdef FTY_ALERT_ENGINE_PROBES
+#define trace_probe(name)                      DTRACE_PROBE(fty_alert_engine, name)
+#define trace_probe1(name, a1)                 DTRACE_PROBE1(fty_alert_engine, name, a1)
+#define trace_probe2(name, a1, a2)             DTRACE_PROBE2(fty_alert_engine, name, a1, a2)
+#define trace_probe3(name, a1, a2, a3)         DTRACE_PROBE3(fty_alert_engine, name, a1, a2, a3)
+#define trace_probe4(name, a1, a2, a3, a4)     DTRACE_PROBE4(fty_alert_engine, name, a1, a2, a3, a4)
+#else
+// arguments are only named, not evaluated, so values computed for a probe are not reported unused
+#define trace_probe(name)                      do {} while (0)
+#define trace_probe1(name, a1)                 do { (void)sizeof(a1); } while (0)
+#define trace_probe2(name, a1, a2)             do { (void)sizeof(a1); (void)sizeof(a2); } while (0)
+#define trace_probe3(name, a1, a2, a3)         do { (void)sizeof(a1); (void)sizeof(a2); (void)sizeof(a3); } while (0)
+#define trace_probe4(name, a1, a2, a3, a4)                                                                             \
+    do {                                                                                                               \
+        (void)sizeof(a1);                                                                                              \
+        (void)sizeof(a2);                                                                                              \
+        (void)sizeof(a3);                                                                                              \
+        (void)sizeof(a4);                                                                                              \
+    } while (0)
+#endif
@@ -44,6 +44,7 @@ public:
     std::vector<std::string> _actions;
     std::string              _rule_class;
     uint64_t                 _ttl;
+    uint64_t                 _metricTime = 0; // time of the metric which triggered the alert, 0 when unknown
 
     PureAlert()
         : _timestamp{0} {};
@@ -77,6 +77,17 @@ enum RULE_RESULT
 };
 
 class Rule;
+
+/// Evaluation counters of a rule, guarded by the lock of the rules (like the rule itself)
+struct RuleStats
+{
+    uint64_t evaluations = 0; // evaluate() calls
+    uint64_t skipped     = 0; // evaluations without all input metrics
+    uint64_t errors      = 0; // failed evaluations, skipped ones excluded
+    uint64_t alerts      = 0; // alerts sent
+    uint64_t totalTime   = 0; // cumulative evaluation time, ns
+    uint64_t maxTime     = 0; // longest evaluation, ns
+};
 using RulePtr = std::unique_ptr<Rule>;
 
 /// General representation for rules
@@ -93,6 +104,16 @@ public:
         return _name;
     }
 
+    /// Evaluation counters, see STATS command
+    RuleStats& stats()
+    {
+        return _stats;
+    }
+    const RuleStats& stats() const
+    {
+        return _stats;
+    }
+
     void name(const std::string& name)
     {
         _name = name;
@@ -261,6 +282,8 @@ protected:
     /// Human readable info about this rule purpose like "internal temperature"
     std::string _rule_class;
 
+    RuleStats _stats;
+
 private:
     /// User is able to define his own constants, that can be used in evaluation function
     ///
@@ -0,0 +1,105 @@
+/*  =========================================================================
+    rulechannel - In-process channel of rules from autoconfig to the alert engine
+
+    Copyright (C) 2014 - 2021 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#include "rulechannel.h"
+#include <fty_log.h>
+
+#define RULE_CHANNEL_ENDPOINT "inproc://fty-alert-engine-rules"
+
+std::mutex          RuleChannel::_mtx;
+std::string         RuleChannel::_name;
+zsock_t*            RuleChannel::_pull = NULL;
+zsock_t*            RuleChannel::_push = NULL;
+std::deque<RulePtr> RuleChannel::_queue;
+
+zsock_t* RuleChannel::bind(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(_mtx);
+    if (!_name.empty()) {
+        log_warning("rule channel already bound by '%s', '%s' uses the mailbox only", _name.c_str(), name.c_str());
+        return NULL;
+    }
+    _pull = zsock_new_pull("@" RULE_CHANNEL_ENDPOINT);
+    _push = zsock_new_push(">" RULE_CHANNEL_ENDPOINT);
+    if (!_pull || !_push) {
+        log_error("can't create rule channel sockets");
+        zsock_destroy(&_pull);
+        zsock_destroy(&_push);
+        return NULL;
+    }
+    _name = name;
+    return _pull;
+}
+
+void RuleChannel::unbind(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(_mtx);
+    if (_name != name) {
+        return;
+    }
+    if (!_queue.empty()) {
+        log_warning("rule channel closed, %zu rule(s) dropped", _queue.size());
+    }
+    _queue.clear();
+    zsock_destroy(&_push);
+    zsock_destroy(&_pull);
+    _name.clear();
+}
+
+bool RuleChannel::bound(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(_mtx);
+    return !_name.empty() && _name == name;
+}
+
+bool RuleChannel::push(const std::string& name, RulePtr& rule)
+{
+    std::lock_guard<std::mutex> lock(_mtx);
+    if (_name.empty() || _name != name) {
+        return false;
+    }
+    _queue.push_back(std::move(rule));
+    if (_queue.size() == 1) {
+        // consumer takes the whole queue, so one wake up per non-empty period is enough
+        zstr_send(_push, "RULES");
+    }
+    return true;
+}
+
+std::vector<RulePtr> RuleChannel::take()
+{
+    std::lock_guard<std::mutex> lock(_mtx);
+    std::vector<RulePtr>        rules;
+    if (!_pull) {
+        return rules;
+    }
+    // consume wake ups first, a rule pushed after this point signals again
+    while (zsock_events(_pull) & ZMQ_POLLIN) {
+        char* signal = zstr_recv(_pull);
+        zstr_free(&signal);
+    }
+    rules.reserve(_queue.size());
+    for (auto& rule : _queue) {
+        rules.push_back(std::move(rule));
+    }
+    _queue.clear();
+    return rules;
+}
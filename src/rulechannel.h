@@ -0,0 +1,68 @@
+/*  =========================================================================
+    rulechannel - In-process channel of rules from autoconfig to the alert engine
+
+    Copyright (C) 2014 - 2021 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+
+#include "rule.h"
+#include <czmq.h>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/// Hands parsed rules from autoconfig to the alert engine running in the same process
+///
+/// Autoconfig and the engine mailbox actor share the process, yet every generated rule used to be
+/// serialized, sent through malamute and parsed again in the engine actor. The channel passes the
+/// parsed rule instead; the engine only inserts it. Rules for engines of other processes (and for
+/// fty-alert-flexible) still go through malamute.
+///
+/// One consumer at a time: the engine actor binds the channel under its mailbox name, producers
+/// push rules addressed to that name. The consumer is woken through an inproc socket which gets
+/// one message whenever the queue becomes non-empty.
+class RuleChannel
+{
+public:
+    /// Registers the consumer
+    /// @param[in] name - mailbox name of the engine
+    /// @return socket to poll, readable when rules are queued, NULL when channel is already bound
+    static zsock_t* bind(const std::string& name);
+
+    /// Unregisters the consumer, drops rules not yet taken
+    static void unbind(const std::string& name);
+
+    /// Checks if an engine of this name consumes the channel
+    static bool bound(const std::string& name);
+
+    /// Queues rule for the engine
+    /// @return false when no engine of this name consumes the channel, rule is left untouched
+    static bool push(const std::string& name, RulePtr& rule);
+
+    /// Takes all queued rules, called by the consumer when its socket is readable
+    static std::vector<RulePtr> take();
+
+private:
+    static std::mutex          _mtx;
+    static std::string         _name; // consumer, empty when unbound
+    static zsock_t*            _pull; // consumer side of the wake up socket
+    static zsock_t*            _push; // producer side, used under _mtx
+    static std::deque<RulePtr> _queue;
+};
@@ -20,36 +20,103 @@
 */
 
 #include "ruleconfigurator.h"
-//#include <regex>
-#include <cxxtools/regex.h>
+#include "alertconfiguration.h"
+#include "rulechannel.h"
+#include <sstream>
+#include <cxxtools/jsondeserializer.h>
+
+const char* RuleConfigurator::ruleDestination(const std::string& rule)
+{
+    return ruleDestination(RuleTemplate::isFlexible(rule));
+}
+
+const char* RuleConfigurator::ruleDestination(bool flexible)
+{
+    return flexible ? "fty-alert-flexible" : Autoconfig::AlertEngineName.c_str();
+}
+
+// sends rules request, nobody waits for the reply (see Autoconfig::main)
+static bool s_send_rules_request(mlm_client_t* client, const char* dest, zmsg_t** message)
+{
+    const char* subject = "rfc-evaluator-rules";
+    log_debug("Sending '%s' to '%s'", subject, dest);
+
+    if (mlm_client_sendto(client, dest, subject, NULL, 5000, message) != 0) {
+        log_error("mlm_client_sendto (address = '%s', subject = '%s', timeout = '5000') failed.", dest,
+            subject);
+        return false;
+    }
+    return true;
+}
 
 bool RuleConfigurator::sendNewRule(const std::string& rule, mlm_client_t* client)
+{
+    RulePtr parsed;
+    return sendNewRule(rule, ruleDestination(rule), parsed, client);
+}
+
+bool RuleConfigurator::sendNewRule(const std::string& rule, const char* dest, RulePtr& parsed, mlm_client_t* client)
 {
     if (!client)
         return false;
 
+    // engine of this process takes the parsed rule directly, without the malamute round trip
+    if (RuleChannel::bound(dest)) {
+        if (!parsed) {
+            std::istringstream f(rule);
+            int                rv = readRule(f, parsed);
+            if (rv != 0) {
+                // the engine would refuse it the same way, sending it again doesn't help
+                log_error("Rule for '%s' not added, %s", dest, (rv == 2) ? "BAD_LUA" : "BAD_JSON");
+                return true;
+            }
+        }
+        std::string rule_name = parsed->name();
+        if (RuleChannel::push(dest, parsed)) {
+            log_debug("Queued rule '%s' for '%s'", rule_name.c_str(), dest);
+            return true;
+        }
+        // engine is gone in the meantime, use the mailbox
+    }
+
     zmsg_t* message = zmsg_new();
     zmsg_addstr(message, "ADD");
     zmsg_addstr(message, rule.c_str());
+    return s_send_rules_request(client, dest, &message);
+}
 
-    const char* dest = Autoconfig::AlertEngineName.c_str();
-
-    // CAUTION: regression issue "std::regex don't match 'flexible' rule"
-    //std::regex reg("^[[:blank:][:cntrl:]]*\\{[[:blank:][:cntrl:]]*\"flexible\"", std::regex::extended);
-    //if (std::regex_match(rule, reg))
-    //    dest = "fty-alert-flexible";
+bool RuleConfigurator::sendDeleteRule(const GeneratedRule& rule, mlm_client_t* client)
+{
+    if (!client)
+        return false;
 
-    cxxtools::Regex reg("^[[:blank:][:cntrl:]]*\\{[[:blank:][:cntrl:]]*\"flexible\"", REG_EXTENDED);
-    if (reg.match(rule))
-        dest = "fty-alert-flexible";
+    zmsg_t* message = zmsg_new();
+    zmsg_addstr(message, "DELETE");
+    zmsg_addstr(message, rule.name.c_str());
+    return s_send_rules_request(client, rule.dest.c_str(), &message);
+}
 
-    const char* subject = "rfc-evaluator-rules";
-    log_debug("Sending '%s/ADD' to '%s'", subject, dest);
+std::string RuleConfigurator::ruleName(const std::string& rule)
+{
+    try {
+        cxxtools::SerializationInfo si;
+        std::istringstream          in(rule);
+        cxxtools::JsonDeserializer  json(in);
+        json.deserialize(si);
+        if (si.memberCount() == 0)
+            return "";
 
-    if (mlm_client_sendto(client, dest, subject, NULL, 5000, &message) != 0) {
-        log_error("mlm_client_sendto (address = '%s', subject = '%s', timeout = '5000') failed.", dest,
-            subject);
-        return false;
+        // {"<rule type>": {"rule_name": ...}}, flexible rules use "name"
+        const cxxtools::SerializationInfo& body = si.getMember(0);
+        const cxxtools::SerializationInfo* name = body.findMember("rule_name");
+        if (!name)
+            name = body.findMember("name");
+        std::string result;
+        if (name)
+            name->getValue(result);
+        return result;
+    } catch (const std::exception& e) {
+        log_error("Can't read rule name: %s", e.what());
     }
-    return true;
+    return "";
 }
@@ -22,6 +22,8 @@
 #pragma once
 
 #include "autoconfig.h"
+#include "rule.h"
+#include "ruletemplatecache.h"
 #include <malamute.h>
 #include <map>
 #include <string>
@@ -47,6 +49,17 @@ public:
     }
 
     bool sendNewRule(const std::string& rule, mlm_client_t* client);
+    /// Sends rule to dest, parsed is used (and moved from) when it goes to the engine of this process
+    /// @param[in,out] parsed - rule already parsed from rule, parsed again when empty
+    bool sendNewRule(const std::string& rule, const char* dest, RulePtr& parsed, mlm_client_t* client);
+    /// Deletes previously generated rule (DELETE/rule_name)
+    bool sendDeleteRule(const GeneratedRule& rule, mlm_client_t* client);
+    /// Reads name of the rule, empty on error
+    static std::string ruleName(const std::string& rule);
+    /// Mailbox which the rule is sent to
+    static const char* ruleDestination(const std::string& rule);
+    /// Mailbox which flexible (or other) rules are sent to
+    static const char* ruleDestination(bool flexible);
 
     virtual ~RuleConfigurator(){};
 };
@@ -0,0 +1,185 @@
+/*  =========================================================================
+    ruletemplatecache - In-memory cache of rule templates
+
+    Copyright (C) 2014 - 2021 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#include "ruletemplatecache.h"
+#include "autoconfig.h"
+#include <cassert>
+#include <cctype>
+#include <cstring>
+#include <cxxtools/directory.h>
+#include <fstream>
+#include <fty_log.h>
+#include <sys/stat.h>
+
+// must follow RuleTemplate::Token order
+static const char* tokenPatterns[RuleTemplate::TOKEN_COUNT] = {"__name__", "__port__", "__logicalasset__",
+    "__logicalasset_iname__", "__severity__", "__normalstate__", "__rule_result__", "__ename__"};
+
+RuleTemplate::RuleTemplate(const std::string& name, const std::string& text)
+    : _name(name)
+    , _text(text)
+    , _flexible(isFlexible(text))
+{
+    size_t literal = 0;
+    size_t pos     = 0;
+    while ((pos = _text.find("__", pos)) != std::string::npos) {
+        int token = -1;
+        for (int i = 0; i < TOKEN_COUNT; i++) {
+            if (_text.compare(pos, strlen(tokenPatterns[i]), tokenPatterns[i]) == 0) {
+                token = i;
+                break;
+            }
+        }
+        if (token < 0) {
+            pos++;
+            continue;
+        }
+        _segments.push_back({literal, pos - literal, token});
+        pos += strlen(tokenPatterns[token]);
+        literal = pos;
+    }
+    _segments.push_back({literal, _text.size() - literal, -1});
+}
+
+bool RuleTemplate::isFlexible(const std::string& text)
+{
+    // same as regex ^[[:blank:][:cntrl:]]*\{[[:blank:][:cntrl:]]*"flexible"
+    auto skip = [&text](size_t pos) {
+        while (pos < text.size() && (isblank(text[pos]) || iscntrl(text[pos]))) {
+            pos++;
+        }
+        return pos;
+    };
+
+    size_t pos = skip(0);
+    if (pos >= text.size() || text[pos] != '{') {
+        return false;
+    }
+    return text.compare(skip(pos + 1), 10, "\"flexible\"") == 0;
+}
+
+std::string RuleTemplate::instantiate(const std::vector<std::string>& replacements) const
+{
+    assert(replacements.size() == TOKEN_COUNT);
+
+    size_t size = 0;
+    for (const auto& segment : _segments) {
+        size += segment.literalLen;
+        if (segment.token >= 0) {
+            size += replacements[static_cast<size_t>(segment.token)].size();
+        }
+    }
+
+    std::string result;
+    result.reserve(size);
+    for (const auto& segment : _segments) {
+        result.append(_text, segment.literalPos, segment.literalLen);
+        if (segment.token >= 0) {
+            result.append(replacements[static_cast<size_t>(segment.token)]);
+        }
+    }
+    return result;
+}
+
+RuleTemplateSet::RuleTemplateSet(const std::string& path, bool exists)
+    : _exists(exists)
+{
+    if (!_exists) {
+        return;
+    }
+    cxxtools::Directory d(path);
+    log_info("load all templates from %s", d.path().c_str());
+    for (const auto& fn : d) {
+        if (fn.compare(".") != 0 && fn.compare("..") != 0) {
+            try {
+                // read the template rule from the file
+                std::ifstream f(d.path() + "/" + fn);
+                std::string   str((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+                _byName[fn] = _templates.size();
+                _templates.emplace_back(fn, str);
+            } catch (const std::exception& e) {
+                log_error("error loading %s/%s (e: %s)", d.path().c_str(), fn.c_str(), e.what());
+            }
+        }
+    }
+}
+
+const RuleTemplate* RuleTemplateSet::find(const std::string& name) const
+{
+    auto it = _byName.find(name);
+    return (it != _byName.end()) ? &_templates[it->second] : nullptr;
+}
+
+const RuleTemplateSet::Templates& RuleTemplateSet::ofType(const std::string& type_name) const
+{
+    std::lock_guard<std::mutex> lock(_mtx);
+
+    auto it = _byType.find(type_name);
+    if (it != _byType.end()) {
+        return it->second;
+    }
+    Templates matching;
+    for (const auto& templat : _templates) {
+        if (templat.name().find(type_name) != std::string::npos) {
+            matching.push_back(&templat);
+        }
+    }
+    return _byType.emplace(type_name, std::move(matching)).first->second;
+}
+
+std::mutex                             RuleTemplateCache::_mtx;
+RuleTemplateCache::Signature           RuleTemplateCache::_signature;
+std::shared_ptr<const RuleTemplateSet> RuleTemplateCache::_set;
+
+RuleTemplateCache::Signature RuleTemplateCache::signature(const std::string& path)
+{
+    Signature   sig;
+    struct stat st;
+    sig.path = path;
+    if (stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+        sig.exists = true;
+        sig.ino    = st.st_ino;
+        sig.sec    = st.st_mtim.tv_sec;
+        sig.nsec   = st.st_mtim.tv_nsec;
+    }
+    return sig;
+}
+
+std::shared_ptr<const RuleTemplateSet> RuleTemplateCache::get()
+{
+    Signature sig = signature(Autoconfig::RuleFilePath);
+
+    std::lock_guard<std::mutex> lock(_mtx);
+    if (!_set || !(sig == _signature)) {
+        if (_set) {
+            log_debug("templates directory '%s' changed, reloading templates", sig.path.c_str());
+        }
+        _set       = std::make_shared<const RuleTemplateSet>(sig.path, sig.exists);
+        _signature = sig;
+    }
+    return _set;
+}
+
+void RuleTemplateCache::invalidate()
+{
+    std::lock_guard<std::mutex> lock(_mtx);
+    _set.reset();
+}
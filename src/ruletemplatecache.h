@@ -0,0 +1,166 @@
+/*  =========================================================================
+    ruletemplatecache - In-memory cache of rule templates
+
+    Copyright (C) 2014 - 2021 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+#include <unordered_map>
+#include <vector>
+
+/// Rule template split into literal text and placeholders
+///
+/// Template is scanned once, instantiation is one concatenation of literals and replacements.
+class RuleTemplate
+{
+public:
+    /// Placeholders, replacements are passed in this order
+    enum Token
+    {
+        NAME = 0,            // __name__
+        PORT,                // __port__
+        LOGICAL_ASSET,       // __logicalasset__
+        LOGICAL_ASSET_INAME, // __logicalasset_iname__
+        SEVERITY,            // __severity__
+        NORMAL_STATE,        // __normalstate__
+        RULE_RESULT,         // __rule_result__
+        ENAME,               // __ename__
+        TOKEN_COUNT
+    };
+
+    RuleTemplate(const std::string& name, const std::string& text);
+
+    /// File name of the template
+    const std::string& name() const
+    {
+        return _name;
+    }
+
+    /// Raw content of the template
+    const std::string& text() const
+    {
+        return _text;
+    }
+
+    /// Rules of the template are for fty-alert-flexible
+    bool flexible() const
+    {
+        return _flexible;
+    }
+
+    /// Top-level key of the rule is "flexible"
+    static bool isFlexible(const std::string& text);
+
+    /// Generates the rule
+    /// @param[in] replacements - value for every Token, in the Token order
+    /// @return template with all placeholders replaced
+    std::string instantiate(const std::vector<std::string>& replacements) const;
+
+private:
+    struct Segment
+    {
+        size_t literalPos;
+        size_t literalLen;
+        int    token; // Token following the literal, -1 for the last segment
+    };
+
+    std::string          _name;
+    std::string          _text;
+    std::vector<Segment> _segments;
+    bool                 _flexible;
+};
+
+/// Templates of one directory, immutable once loaded
+class RuleTemplateSet
+{
+public:
+    typedef std::vector<const RuleTemplate*> Templates;
+
+    RuleTemplateSet(const std::string& path, bool exists);
+
+    /// Templates directory exists
+    bool exists() const
+    {
+        return _exists;
+    }
+
+    /// All templates in directory order
+    const std::vector<RuleTemplate>& all() const
+    {
+        return _templates;
+    }
+
+    /// Gets template by its file name
+    /// @return template or nullptr if there is none
+    const RuleTemplate* find(const std::string& name) const;
+
+    /// Templates whose file name contains type_name (e.g. __device_ups__)
+    ///
+    /// Result is computed once per type_name and reused.
+    const Templates& ofType(const std::string& type_name) const;
+
+private:
+    bool                                               _exists;
+    std::vector<RuleTemplate>                          _templates;
+    std::unordered_map<std::string, size_t>            _byName; // file name | index to _templates
+    mutable std::mutex                                 _mtx;    // guards _byType
+    mutable std::unordered_map<std::string, Templates> _byType; // type name | matching templates
+};
+
+/// Process wide cache of rule templates of Autoconfig::RuleFilePath
+///
+/// Templates are read on first use and again only when the directory (or its path) changes.
+/// Change is detected by the directory modification time, which is updated when templates are
+/// added, removed or replaced by rename (as package installation does).
+class RuleTemplateCache
+{
+public:
+    /// Gets current templates, reloads them if the directory changed
+    static std::shared_ptr<const RuleTemplateSet> get();
+
+    /// Forgets loaded templates, next get() reloads them
+    static void invalidate();
+
+private:
+    struct Signature
+    {
+        std::string path;
+        bool        exists = false;
+        ino_t       ino    = 0;
+        time_t      sec    = 0;
+        long        nsec   = 0;
+
+        bool operator==(const Signature& other) const
+        {
+            return path == other.path && exists == other.exists && ino == other.ino && sec == other.sec &&
+                   nsec == other.nsec;
+        }
+    };
+
+    static Signature signature(const std::string& path);
+
+    static std::mutex                             _mtx;
+    static Signature                              _signature;
+    static std::shared_ptr<const RuleTemplateSet> _set;
+};
@@ -0,0 +1,456 @@
+/*  =========================================================================
+    statejournal - Autoconfig state snapshot and change journal
+
+    Copyright (C) 2014 - 2021 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#include "statejournal.h"
+#include "autoconfig.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <fty_log.h>
+#include <unistd.h>
+
+// journal is compacted when it has more records than this and than devices in the state
+#define STATE_JOURNAL_MIN_RECORDS 1000
+
+static const char SNAPSHOT_MAGIC[] = "FTYACS01";
+static const char JOURNAL_MAGIC[]  = "FTYACJ01";
+
+static const size_t MAGIC_SIZE = 8;
+
+static const char RECORD_PUT    = 'P';
+static const char RECORD_REMOVE = 'D';
+static const char RECORD_RULES  = 'R';
+
+// Record: u32 payload size | u32 payload checksum | payload
+// Payload: u8 type | str name [| str type | str subtype | str operation | str update_ts | u8 configured |
+//          u64 date | u32 attribute count | (str key | str value)...]
+// Rules payload: u8 type | str name | u32 rule count | (str template | u64 hash | str rule name | str dest)...
+// str is u32 size | bytes, integers are in host byte order
+
+static uint32_t s_checksum(const char* data, size_t size)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= static_cast<uint8_t>(data[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+template <typename T>
+static void s_put_int(std::string& buf, T value)
+{
+    buf.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static void s_put_str(std::string& buf, const std::string& str)
+{
+    s_put_int(buf, static_cast<uint32_t>(str.size()));
+    buf.append(str);
+}
+
+static std::string s_frame(const std::string& payload)
+{
+    std::string record;
+    record.reserve(2 * sizeof(uint32_t) + payload.size());
+    s_put_int(record, static_cast<uint32_t>(payload.size()));
+    s_put_int(record, s_checksum(payload.data(), payload.size()));
+    record.append(payload);
+    return record;
+}
+
+static std::string s_put_record(const std::string& name, const AutoConfigurationInfo& info)
+{
+    std::string payload;
+    payload.push_back(RECORD_PUT);
+    s_put_str(payload, name);
+    s_put_str(payload, info.type);
+    s_put_str(payload, info.subtype);
+    s_put_str(payload, info.operation);
+    s_put_str(payload, info.update_ts);
+    s_put_int(payload, static_cast<uint8_t>(info.configured));
+    s_put_int(payload, info.date);
+    s_put_int(payload, static_cast<uint32_t>(info.attributes.size()));
+    for (const auto& attr : info.attributes) {
+        s_put_str(payload, attr.first);
+        s_put_str(payload, attr.second);
+    }
+    return s_frame(payload);
+}
+
+static std::string s_rules_record(const std::string& name, const StateJournal::DeviceRules& rules)
+{
+    std::string payload;
+    payload.push_back(RECORD_RULES);
+    s_put_str(payload, name);
+    s_put_int(payload, static_cast<uint32_t>(rules.size()));
+    for (const auto& rule : rules) {
+        s_put_str(payload, rule.first);
+        s_put_int(payload, rule.second.hash);
+        s_put_str(payload, rule.second.name);
+        s_put_str(payload, rule.second.dest);
+    }
+    return s_frame(payload);
+}
+
+static std::string s_remove_record(const std::string& name)
+{
+    std::string payload;
+    payload.push_back(RECORD_REMOVE);
+    s_put_str(payload, name);
+    return s_frame(payload);
+}
+
+// sequential reader over a buffer, every get fails once the buffer is exhausted
+class Reader
+{
+public:
+    Reader(const char* data, size_t size)
+        : _data(data)
+        , _size(size)
+    {
+    }
+
+    template <typename T>
+    bool get(T& value)
+    {
+        if (_size - _pos < sizeof(value)) {
+            return false;
+        }
+        memcpy(&value, _data + _pos, sizeof(value));
+        _pos += sizeof(value);
+        return true;
+    }
+
+    bool get(std::string& str)
+    {
+        uint32_t size;
+        if (!get(size) || _size - _pos < size) {
+            return false;
+        }
+        str.assign(_data + _pos, size);
+        _pos += size;
+        return true;
+    }
+
+    const char* skip(size_t size)
+    {
+        if (_size - _pos < size) {
+            return nullptr;
+        }
+        const char* data = _data + _pos;
+        _pos += size;
+        return data;
+    }
+
+    size_t pos() const
+    {
+        return _pos;
+    }
+
+    bool end() const
+    {
+        return _pos == _size;
+    }
+
+private:
+    const char* _data;
+    size_t      _size;
+    size_t      _pos = 0;
+};
+
+static bool s_apply_rules(Reader& reader, const std::string& name, StateJournal::Rules& rules)
+{
+    StateJournal::DeviceRules deviceRules;
+    uint32_t                  count;
+    if (!reader.get(count)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        std::string   templat;
+        GeneratedRule rule;
+        if (!reader.get(templat) || !reader.get(rule.hash) || !reader.get(rule.name) || !reader.get(rule.dest)) {
+            return false;
+        }
+        deviceRules.emplace(std::move(templat), std::move(rule));
+    }
+    if (!reader.end()) {
+        return false;
+    }
+    if (deviceRules.empty()) {
+        rules.erase(name);
+    } else {
+        rules[name] = std::move(deviceRules);
+    }
+    return true;
+}
+
+static bool s_apply(const char* data, size_t size, StateJournal::Devices& devices, StateJournal::Rules& rules)
+{
+    Reader      reader(data, size);
+    char        type;
+    std::string name;
+    if (!reader.get(type) || !reader.get(name)) {
+        return false;
+    }
+    if (type == RECORD_REMOVE) {
+        devices.erase(name);
+        rules.erase(name);
+        return reader.end();
+    }
+    if (type == RECORD_RULES) {
+        return s_apply_rules(reader, name, rules);
+    }
+    if (type != RECORD_PUT) {
+        return false;
+    }
+    AutoConfigurationInfo info;
+    uint8_t               configured;
+    uint32_t              count;
+    if (!reader.get(info.type) || !reader.get(info.subtype) || !reader.get(info.operation) ||
+        !reader.get(info.update_ts) || !reader.get(configured) || !reader.get(info.date) || !reader.get(count)) {
+        return false;
+    }
+    info.configured = configured != 0;
+    for (uint32_t i = 0; i < count; i++) {
+        std::string key, value;
+        if (!reader.get(key) || !reader.get(value)) {
+            return false;
+        }
+        info.attributes.emplace(std::move(key), std::move(value));
+    }
+    if (!reader.end()) {
+        return false;
+    }
+    devices[name] = std::move(info);
+    return true;
+}
+
+// applies records of buffer (after the magic), returns count of applied records, sets good to the
+// offset following the last valid one
+static size_t s_replay(
+    const std::string& buf, StateJournal::Devices& devices, StateJournal::Rules& rules, size_t& good)
+{
+    Reader reader(buf.data(), buf.size());
+    size_t count = 0;
+    reader.skip(MAGIC_SIZE);
+    good = reader.pos();
+    while (!reader.end()) {
+        uint32_t    size, checksum;
+        const char* payload;
+        if (!reader.get(size) || !reader.get(checksum) || !(payload = reader.skip(size)) ||
+            s_checksum(payload, size) != checksum || !s_apply(payload, size, devices, rules)) {
+            break;
+        }
+        good = reader.pos();
+        count++;
+    }
+    return count;
+}
+
+static bool s_read_file(const std::string& path, std::string& buf)
+{
+    std::ifstream f(path, std::ios::in | std::ios::binary);
+    if (!f) {
+        return false;
+    }
+    buf.assign((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    return !f.bad();
+}
+
+static bool s_write_all(int fd, const std::string& buf)
+{
+    size_t done = 0;
+    while (done < buf.size()) {
+        ssize_t rv = ::write(fd, buf.data() + done, buf.size() - done);
+        if (rv < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        done += static_cast<size_t>(rv);
+    }
+    return true;
+}
+
+StateJournal::~StateJournal()
+{
+    if (_fd >= 0) {
+        ::close(_fd);
+    }
+}
+
+void StateJournal::setPath(const std::string& file)
+{
+    if (file == _file) {
+        return;
+    }
+    if (_fd >= 0) {
+        ::close(_fd);
+        _fd = -1;
+    }
+    _file    = file;
+    _journal = file + ".journal";
+    _records = 0;
+}
+
+int StateJournal::load(Devices& devices, Rules& rules)
+{
+    if (_file.empty()) {
+        return -1;
+    }
+    std::string snapshot;
+    std::string journal;
+    bool        haveSnapshot = s_read_file(_file, snapshot);
+    bool        haveJournal  = s_read_file(_journal, journal);
+
+    if (haveSnapshot && !snapshot.empty() && snapshot.compare(0, MAGIC_SIZE, SNAPSHOT_MAGIC) != 0) {
+        return -2;
+    }
+    if (!haveJournal && (!haveSnapshot || snapshot.empty())) {
+        return -1;
+    }
+
+    devices.clear();
+    rules.clear();
+    size_t good = 0;
+    if (haveSnapshot && !snapshot.empty()) {
+        s_replay(snapshot, devices, rules, good);
+        if (good != snapshot.size()) {
+            log_error("state snapshot '%s' is damaged at offset %zu, ignoring the rest", _file.c_str(), good);
+        }
+    }
+    _records = 0;
+    if (haveJournal && !journal.empty()) {
+        if (journal.compare(0, MAGIC_SIZE, JOURNAL_MAGIC) != 0) {
+            log_error("'%s' is not a state journal, ignoring it", _journal.c_str());
+            good = 0;
+        } else {
+            _records = s_replay(journal, devices, rules, good);
+        }
+        if (good != journal.size()) {
+            // drop torn tail, so that following appends are replayed
+            log_warning("state journal '%s' truncated at offset %zu", _journal.c_str(), good);
+            if (::truncate(_journal.c_str(), static_cast<off_t>(good)) != 0) {
+                log_error("can't truncate '%s': %s", _journal.c_str(), strerror(errno));
+            }
+        }
+    }
+    log_debug("state loaded, %zu devices, rules of %zu devices, %zu journal records", devices.size(), rules.size(),
+        _records);
+    return 0;
+}
+
+int StateJournal::append(const std::string& record)
+{
+    if (_file.empty()) {
+        log_error("Can't save state, state file is not set");
+        return -1;
+    }
+    if (_fd < 0) {
+        _fd = ::open(_journal.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+        if (_fd < 0) {
+            log_error("can't open state journal '%s': %s", _journal.c_str(), strerror(errno));
+            return -1;
+        }
+        if (::lseek(_fd, 0, SEEK_END) == 0 && !s_write_all(_fd, std::string(JOURNAL_MAGIC, MAGIC_SIZE))) {
+            log_error("can't write state journal '%s': %s", _journal.c_str(), strerror(errno));
+            ::close(_fd);
+            _fd = -1;
+            return -1;
+        }
+    }
+    if (!s_write_all(_fd, record)) {
+        log_error("can't write state journal '%s': %s", _journal.c_str(), strerror(errno));
+        return -1;
+    }
+    _records++;
+    return 0;
+}
+
+int StateJournal::put(const std::string& name, const AutoConfigurationInfo& info)
+{
+    return append(s_put_record(name, info));
+}
+
+int StateJournal::putRules(const std::string& name, const DeviceRules& rules)
+{
+    return append(s_rules_record(name, rules));
+}
+
+int StateJournal::remove(const std::string& name)
+{
+    return append(s_remove_record(name));
+}
+
+int StateJournal::compact(const Devices& devices, const Rules& rules)
+{
+    if (_file.empty()) {
+        log_error("Can't save state, state file is not set");
+        return -1;
+    }
+    std::string tmp = _file + ".tmp";
+    try {
+        std::ofstream f(tmp, std::ios::out | std::ios::binary | std::ios::trunc);
+        f.exceptions(~std::ofstream::goodbit);
+        f.write(SNAPSHOT_MAGIC, MAGIC_SIZE);
+        for (const auto& device : devices) {
+            std::string record = s_put_record(device.first, device.second);
+            f.write(record.data(), static_cast<std::streamsize>(record.size()));
+        }
+        for (const auto& device : rules) {
+            if (device.second.empty()) {
+                continue;
+            }
+            std::string record = s_rules_record(device.first, device.second);
+            f.write(record.data(), static_cast<std::streamsize>(record.size()));
+        }
+        f.close();
+    } catch (const std::exception& e) {
+        log_error("Can't write state snapshot '%s': %s", tmp.c_str(), e.what());
+        ::unlink(tmp.c_str());
+        return -1;
+    }
+    if (::rename(tmp.c_str(), _file.c_str()) != 0) {
+        log_error("Can't replace state snapshot '%s': %s", _file.c_str(), strerror(errno));
+        ::unlink(tmp.c_str());
+        return -1;
+    }
+    // records of the journal are in the snapshot now, replaying them again would be harmless
+    if (_fd >= 0) {
+        ::close(_fd);
+        _fd = -1;
+    }
+    if (::unlink(_journal.c_str()) != 0 && errno != ENOENT) {
+        log_error("Can't remove state journal '%s': %s", _journal.c_str(), strerror(errno));
+    }
+    _records = 0;
+    log_debug("state compacted, %zu devices, rules of %zu devices", devices.size(), rules.size());
+    return 0;
+}
+
+bool StateJournal::needsCompaction(size_t deviceCount) const
+{
+    return _records > std::max<size_t>(STATE_JOURNAL_MIN_RECORDS, deviceCount);
+}
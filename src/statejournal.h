@@ -0,0 +1,92 @@
+/*  =========================================================================
+    statejournal - Autoconfig state snapshot and change journal
+
+    Copyright (C) 2014 - 2021 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+
+#include <map>
+#include <string>
+
+struct AutoConfigurationInfo;
+struct GeneratedRule;
+
+/// Persistent autoconfig state: binary snapshot plus append-only journal of changes
+///
+/// State consists of the devices and of the rules generated for them, so that only changed rules are sent
+/// after restart.
+///
+/// Every device change appends one record to <file>.journal, so the cost of a change doesn't
+/// depend on the number of devices. The snapshot <file> is rewritten (and the journal emptied)
+/// only by compact(), callers do so when the journal outgrows the state (see needsCompaction()).
+/// Loading reads the snapshot and replays the journal; a torn record at the end of the journal
+/// (crash during append) ends the replay.
+class StateJournal
+{
+public:
+    typedef std::map<std::string, AutoConfigurationInfo> Devices;
+    typedef std::map<std::string, GeneratedRule>         DeviceRules; // template name | rule, see GeneratedRules
+    typedef std::map<std::string, DeviceRules>           Rules;       // device | rules generated for it
+
+    StateJournal() = default;
+    StateJournal(const StateJournal&) = delete;
+    StateJournal& operator=(const StateJournal&) = delete;
+    ~StateJournal();
+
+    /// Sets the snapshot file, journal is the same path with .journal suffix
+    void setPath(const std::string& file);
+
+    /// Reads snapshot and journal into devices and rules
+    /// @return 0 on success, -1 when there is no state, -2 when the snapshot is not in binary
+    ///         format (devices and rules are left untouched, caller may read it as legacy JSON)
+    int load(Devices& devices, Rules& rules);
+
+    /// Records added or updated device
+    /// @return 0 on success, -1 on error
+    int put(const std::string& name, const AutoConfigurationInfo& info);
+
+    /// Records rules generated for device, replacing the previous ones
+    /// @return 0 on success, -1 on error
+    int putRules(const std::string& name, const DeviceRules& rules);
+
+    /// Records removed device, together with its rules
+    /// @return 0 on success, -1 on error
+    int remove(const std::string& name);
+
+    /// Writes devices and rules as the new snapshot and empties the journal
+    /// @return 0 on success, -1 on error
+    int compact(const Devices& devices, const Rules& rules);
+
+    /// Journal has more records than the state has devices (and more than a minimal amount)
+    bool needsCompaction(size_t deviceCount) const;
+
+    /// Count of records in the journal
+    size_t records() const
+    {
+        return _records;
+    }
+
+private:
+    int append(const std::string& record);
+
+    std::string _file;
+    std::string _journal;
+    int         _fd      = -1; // journal opened for append, -1 when not open
+    size_t      _records = 0;
+};
@@ -20,18 +20,167 @@
 */
 
 #include "templateruleconfigurator.h"
+#include "alertconfiguration.h"
 #include "autoconfig.h"
+#include "rulechannel.h"
+#include "ruletemplatecache.h"
 #include <algorithm>
-#include <cxxtools/directory.h>
-#include <fty/convert.h>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
 #include <fty_proto.h>
 #include <fty_shm.h>
+#include <mutex>
 #include <regex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
 
 bool gDisable_ruleXphaseIsApplicable{false}; // PQSWMBT-4921, to pass selftest (require autoconfig)
 
+// per phase metrics which tell the phase count of an asset when it has no phases.* attribute
+enum PhaseMetrics
+{
+    INPUT_VOLTAGE = 0, // voltage.input.Lx-N
+    INPUT_LOAD,        // load.input.Lx
+    OUTPUT_REALPOWER,  // realpower.output.Lx
+    PHASE_METRICS_COUNT
+};
+
+static const char* phaseMetrics[PHASE_METRICS_COUNT][3] = {
+    {"voltage.input.L1-N", "voltage.input.L2-N", "voltage.input.L3-N"},
+    {"load.input.L1", "load.input.L2", "load.input.L3"},
+    {"realpower.output.L1", "realpower.output.L2", "realpower.output.L3"},
+};
+
+// Xphase rule: <rule>@<assetPrefix>... is applicable only for assets with phases phases
+struct XphaseRule
+{
+    const char*  assetPrefix;
+    int          phases;
+    const char*  attribute; // ext. attribute with the phase count, nullptr when asset has none
+    PhaseMetrics metrics;   // used when asset info is not available (or asset has no attribute)
+};
+
+// rule name part before '@' | Xphase rules
+static const std::unordered_map<std::string, std::vector<XphaseRule>> xphaseRules = {
+    // voltage.input_1phase@__device_ups__.rule, voltage.input_1phase@__device_epdu__.rule
+    {"voltage.input_1phase",
+        {{"ups-", 1, "phases.input", INPUT_VOLTAGE}, {"epdu-", 1, "phases.input", INPUT_VOLTAGE}}},
+    // voltage.input_3phase@__device_ups__.rule, voltage.input_3phase@__device_epdu__.rule
+    {"voltage.input_3phase",
+        {{"ups-", 3, "phases.input", INPUT_VOLTAGE}, {"epdu-", 3, "phases.input", INPUT_VOLTAGE}}},
+    // load.input_1phase@__device_epdu__.rule
+    {"load.input_1phase", {{"epdu-", 1, "phases.input", INPUT_LOAD}}},
+    // load.input_3phase@__device_epdu__.rule
+    {"load.input_3phase", {{"epdu-", 3, "phases.input", INPUT_LOAD}}},
+    // phase_imbalance@__device_ups__.rule, phase_imbalance@__device_epdu__.rule,
+    // phase_imbalance@__datacenter__.rule, phase_imbalance@__rack__.rule (3phase rules)
+    // epdu has no phases.output, assume phases.input == phases.output
+    // datacenter and rack have no phases.* ext. attributes
+    {"phase_imbalance",
+        {{"ups-", 3, "phases.output", OUTPUT_REALPOWER}, {"epdu-", 3, "phases.input", OUTPUT_REALPOWER},
+            {"datacenter-", 3, nullptr, OUTPUT_REALPOWER}, {"rack-", 3, nullptr, OUTPUT_REALPOWER}}},
+};
+
+// rules of this many due devices are generated by several threads
+#define RENDER_PARALLEL_MIN_DEVICES 16
+// maximum number of threads generating rules
+#define RENDER_WORKERS 4u
+
+// how long phase counts read from SHM are trusted, metrics may appear after the asset
+#define PHASE_CACHE_TTL_MS 60000
+
+// phase counts of assets detected by metrics presence in SHM
+struct PhaseCacheItem
+{
+    int      phases[PHASE_METRICS_COUNT] = {-1, -1, -1}; // -1 not read yet, 0 neither 1 nor 3 phases
+    uint64_t expires                     = 0;
+};
+
+static std::mutex                                      phaseCacheMutex;
+static std::unordered_map<std::string, PhaseCacheItem> phaseCache;      // asset | phase counts
+static uint64_t                                        phaseCacheSweep; // [ms] next drop of expired entries
+
+// drops expired entries, e.g. of assets deleted meanwhile, at most once per ttl; phaseCacheMutex is held
+static void s_phase_cache_prune(uint64_t now)
+{
+    if (now < phaseCacheSweep)
+        return;
+    phaseCacheSweep = now + PHASE_CACHE_TTL_MS;
+    for (auto it = phaseCache.begin(); it != phaseCache.end();) {
+        if (it->second.expires <= now)
+            it = phaseCache.erase(it);
+        else
+            ++it;
+    }
+}
+
+// phase count of asset according to the presence of its per phase metrics
+static int s_metrics_phases(const std::string& asset, PhaseMetrics metrics)
+{
+    uint64_t now = static_cast<uint64_t>(zclock_mono());
+    {
+        std::lock_guard<std::mutex> lock(phaseCacheMutex);
+        s_phase_cache_prune(now);
+        auto it = phaseCache.find(asset);
+        if (it != phaseCache.end() && it->second.expires > now && it->second.phases[metrics] >= 0)
+            return it->second.phases[metrics];
+    }
+
+    std::string foo;
+    bool        present[3];
+    for (int i = 0; i < 3; i++)
+        present[i] = (fty::shm::read_metric_value(asset, phaseMetrics[metrics][i], foo) == 0);
+    int phases = 0;
+    if (present[0] && !present[1] && !present[2])
+        phases = 1;
+    else if (present[0] && present[1] && present[2])
+        phases = 3;
+
+    std::lock_guard<std::mutex> lock(phaseCacheMutex);
+    PhaseCacheItem&             item = phaseCache[asset];
+    if (item.expires <= now) {
+        item         = PhaseCacheItem();
+        item.expires = now + PHASE_CACHE_TTL_MS;
+    }
+    item.phases[metrics] = phases;
+    return phases;
+}
+
+static const XphaseRule* s_xphase_rule(const std::string& ruleName, std::string& asset)
+{
+    auto pos = ruleName.find("@");
+    if (pos == std::string::npos)
+        return nullptr;
+
+    auto it = xphaseRules.find(ruleName.substr(0, pos));
+    if (it == xphaseRules.end())
+        return nullptr;
+
+    for (const auto& rule : it->second) {
+        if (ruleName.compare(pos + 1, strlen(rule.assetPrefix), rule.assetPrefix) == 0) {
+            asset = ruleName.substr(pos + 1);
+            return &rule;
+        }
+    }
+    return nullptr;
+}
+
+void ruleXphaseInvalidate(const std::string& asset)
+{
+    std::lock_guard<std::mutex> lock(phaseCacheMutex);
+    phaseCache.erase(asset);
+}
+
+bool isXphaseRule(const std::string& ruleName)
+{
+    std::string asset;
+    return s_xphase_rule(ruleName, asset) != nullptr;
+}
+
 // PQSWMBT-4921: Instanciate/expose Xphase rule *only* for Xphase device
-// If the rule is a Xphase rule (1ph/3ph):
+// If the rule is a Xphase rule (1ph/3ph, see xphaseRules):
 //      if the asset match the rule, return true,
 //      else returns false.
 // else return true.
@@ -42,109 +191,21 @@ bool ruleXphaseIsApplicable(const std::string& ruleName, const AutoConfiguration
     if (gDisable_ruleXphaseIsApplicable)
         return true; // pass selftest
 
-    auto pos = ruleName.find("@");
-    if (pos == std::string::npos) {
+    if (ruleName.find("@") == std::string::npos) {
         log_error("malformed ruleName (ruleName: '%s')", ruleName.c_str());
         return false;
     }
 
-    auto asset = ruleName.substr(pos + 1);
-    std::string foo;
-
-    bool isAppl = true; // applicable (default)
-
-    if (   (ruleName.find("voltage.input_1phase@ups-")  == 0)
-        || (ruleName.find("voltage.input_1phase@epdu-") == 0))
-    {
-        // voltage.input_1phase@__device_ups__.rule
-        // voltage.input_1phase@__device_epdu__.rule
-        // is applicable only for 1phase device (phases.input | voltage.input.Lx-N)
-
-        if (assetInfo.empty()) {
-            isAppl =    (fty::shm::read_metric_value(asset, "voltage.input.L1-N", foo) == 0)
-                     && (fty::shm::read_metric_value(asset, "voltage.input.L2-N", foo) != 0)
-                     && (fty::shm::read_metric_value(asset, "voltage.input.L3-N", foo) != 0);
-        }
-        else {
-            isAppl = (assetInfo.getAttr("phases.input") == "1");
-        }
-    }
-    else if (   (ruleName.find("voltage.input_3phase@ups-")  == 0)
-             || (ruleName.find("voltage.input_3phase@epdu-") == 0))
-    {
-        // voltage.input_3phase@__device_ups__.rule
-        // voltage.input_3phase@__device_epdu__.rule
-        // is applicable only for 3phase device (phases.input | voltage.input.Lx-N)
-
-        if (assetInfo.empty()) {
-            isAppl =    (fty::shm::read_metric_value(asset, "voltage.input.L1-N", foo) == 0)
-                     && (fty::shm::read_metric_value(asset, "voltage.input.L2-N", foo) == 0)
-                     && (fty::shm::read_metric_value(asset, "voltage.input.L3-N", foo) == 0);
-        }
-        else {
-            isAppl = (assetInfo.getAttr("phases.input") == "3");
-        }
-    }
-    else if (ruleName.find("load.input_1phase@epdu-") == 0)
-    {
-        // load.input_1phase@__device_epdu__.rule
-        // is applicable only for 1phase device (phases.input | load.input.Lx)
-
-        if (assetInfo.empty()) {
-            isAppl =    (fty::shm::read_metric_value(asset, "load.input.L1", foo) == 0)
-                     && (fty::shm::read_metric_value(asset, "load.input.L2", foo) != 0)
-                     && (fty::shm::read_metric_value(asset, "load.input.L3", foo) != 0);
-        }
-        else {
-            isAppl = (assetInfo.getAttr("phases.input") == "1");
-        }
-    }
-    else if (ruleName.find("load.input_3phase@epdu-") == 0)
-    {
-        // load.input_3phase@__device_epdu__.rule
-        // is applicable only for 3phase device (phases.input | load.input.Lx)
+    std::string       asset;
+    const XphaseRule* rule = s_xphase_rule(ruleName, asset);
+    if (!rule)
+        return true; // applicable (default)
 
-        if (assetInfo.empty()) {
-            isAppl =    (fty::shm::read_metric_value(asset, "load.input.L1", foo) == 0)
-                     && (fty::shm::read_metric_value(asset, "load.input.L2", foo) == 0)
-                     && (fty::shm::read_metric_value(asset, "load.input.L3", foo) == 0);
-        }
-        else {
-            isAppl = (assetInfo.getAttr("phases.input") == "3");
-        }
-    }
-    else if (   (ruleName.find("phase_imbalance@ups-")  == 0)
-             || (ruleName.find("phase_imbalance@epdu-") == 0))
-    {
-        // phase_imbalance@__device_ups__.rule     (3phase rules)
-        // phase_imbalance@__device_epdu__.rule
-        // is applicable only for 3phase device (phases.output | realpower.output.Lx)
-
-        if (assetInfo.empty()) {
-            isAppl =    (fty::shm::read_metric_value(asset, "realpower.output.L1", foo) == 0)
-                     && (fty::shm::read_metric_value(asset, "realpower.output.L2", foo) == 0)
-                     && (fty::shm::read_metric_value(asset, "realpower.output.L3", foo) == 0);
-        }
-        else {
-            // exception for epdu: no phases.output available, assume: phases.input == phases.output
-            if (ruleName.find("@epdu-") != std::string::npos)
-                isAppl = (assetInfo.getAttr("phases.input") == "3");
-            else
-                isAppl = (assetInfo.getAttr("phases.output") == "3");
-        }
-    }
-    else if (   (ruleName.find("phase_imbalance@datacenter-") == 0)
-             || (ruleName.find("phase_imbalance@rack-")       == 0))
-    {
-        // phase_imbalance@__datacenter__.rule     (3phase rules)
-        // phase_imbalance@__rack__.rule
-        // is applicable only for 3phase asset (realpower.output.Lx)
-        // Note: no 'phases.output' ext. attributes for these assets
-
-        isAppl =    (fty::shm::read_metric_value(asset, "realpower.output.L1", foo) == 0)
-                 && (fty::shm::read_metric_value(asset, "realpower.output.L2", foo) == 0)
-                 && (fty::shm::read_metric_value(asset, "realpower.output.L3", foo) == 0);
-    }
+    bool isAppl;
+    if (assetInfo.empty() || !rule->attribute)
+        isAppl = (s_metrics_phases(asset, rule->metrics) == rule->phases);
+    else
+        isAppl = (assetInfo.getAttr(rule->attribute) == std::to_string(rule->phases));
 
     if (!isAppl) {
         log_debug("ruleXphaseIsApplicable: FALSE for rule '%s'", ruleName.c_str());
@@ -154,6 +215,24 @@ bool ruleXphaseIsApplicable(const std::string& ruleName, const AutoConfiguration
     return isAppl;
 }
 
+bool ruleXphaseIsKnown(const std::string& ruleName, const AutoConfigurationInfo& assetInfo)
+{
+    if (gDisable_ruleXphaseIsApplicable)
+        return true;
+
+    std::string       asset;
+    const XphaseRule* rule = s_xphase_rule(ruleName, asset);
+    if (!rule)
+        return true;
+
+    int phases;
+    if (assetInfo.empty() || !rule->attribute)
+        phases = s_metrics_phases(asset, rule->metrics);
+    else
+        phases = atoi(assetInfo.getAttr(rule->attribute).c_str());
+    return phases == 1 || phases == 3;
+}
+
 bool
 TemplateRuleConfigurator::configure (
     const std::string& name,
@@ -161,10 +240,34 @@ TemplateRuleConfigurator::configure (
     const std::string &ename_la,
     mlm_client_t *client
 )
+{
+    GeneratedRules generated;
+    return configure(name, info, ename_la, client, generated);
+}
+
+bool
+TemplateRuleConfigurator::configure (
+    const std::string& name,
+    const AutoConfigurationInfo& info,
+    const std::string &ename_la,
+    mlm_client_t *client,
+    GeneratedRules& generated
+)
+{
+    RenderedRules rendered;
+    if (!render(name, info, ename_la, generated, rendered)) {
+        return true;
+    }
+    return apply(name, rendered, client, generated);
+}
+
+bool TemplateRuleConfigurator::render(const std::string& name, const AutoConfigurationInfo& info,
+    const std::string& ename_la, const GeneratedRules& generated, RenderedRules& rendered)
 {
     log_debug("TemplateRuleConfigurator::configure (name = '%s', info.type = '%s', info.subtype = '%s')", name.c_str(),
         info.type.c_str(), info.subtype.c_str());
 
+    rendered.clear();
     if (streq(info.operation.c_str(), FTY_PROTO_ASSET_OP_CREATE) ||
         streq(info.operation.c_str(), FTY_PROTO_ASSET_OP_UPDATE)) {
         std::string port, severity, normal_state, model, iname_la, rule_result, ename;
@@ -190,18 +293,50 @@ TemplateRuleConfigurator::configure (
                 ename = i.second;
         }
 
-        std::vector<std::string> patterns     = {"__name__", "__port__", "__logicalasset__", "__logicalasset_iname__",
-            "__severity__", "__normalstate__", "__rule_result__", "__ename__"};
+        // in RuleTemplate::Token order
         std::vector<std::string> replacements = {
             name, port, ename_la, iname_la, severity, normal_state, rule_result, ename};
 
-        std::vector<std::string> templates = loadTemplates(info.type.c_str(), info.subtype.c_str(), fast_track);
-        bool                     result    = true;
+        auto templates = RuleTemplateCache::get();
+        if (!templates->exists()) {
+            // rules generated before must not be deleted for that
+            log_error("TemplateRuleConfigurator '%s' dir does not exist", Autoconfig::RuleFilePath.c_str());
+            return false;
+        }
+        std::string type_name = convertTypeSubType2Name(info.type.c_str(), info.subtype.c_str());
+
+        for (const RuleTemplate* templat : templates->ofType(type_name)) {
+            if (fast_track) {
+                if (templat->name() == "realpower.default@__datacenter__.rule") {
+                    log_debug("match %s but not use for fast track", templat->name().c_str());
+                    continue;
+                }
+            }
+            log_debug("match %s", templat->name().c_str());
+
+            // engine refuses Xphase rule of device with other phase count, such rule is not generated, so that
+            // it is added or deleted once the phase count changes
+            std::string xphaseName = templat->name().substr(0, templat->name().find('@')) + "@" + name;
+            if (isXphaseRule(xphaseName) && !ruleXphaseIsApplicable(xphaseName, info)) {
+                auto previous = generated.find(templat->name());
+                if (previous != generated.end() && !previous->second.name.empty() &&
+                    !ruleXphaseIsKnown(xphaseName, info)) {
+                    // phase count is missing for a while (metrics not in SHM), the rule is kept as it is
+                    log_debug("keep %s, phases of %s unknown", templat->name().c_str(), name.c_str());
+                    RenderedRule r;
+                    r.templat  = previous->first;
+                    r.hash     = previous->second.hash;
+                    r.flexible = templat->flexible();
+                    rendered.push_back(std::move(r));
+                    continue;
+                }
+                log_debug("skip %s, phases of %s don't match", templat->name().c_str(), name.c_str());
+                continue;
+            }
 
-        for (auto& templat : templates) {
             // extra check for sensorgpio
             if (info.subtype == "sensorgpio") {
-                if (!TemplateRuleConfigurator::isModelOk(model, templat)) {
+                if (!TemplateRuleConfigurator::isModelOk(model, templat->text())) {
                     log_debug("Skip rule for gpio:\n %s", name.c_str());
                     continue;
                 } else {
@@ -210,14 +345,27 @@ TemplateRuleConfigurator::configure (
             }
 
             // generate the rule from the template
-            std::string rule = replaceTokens(templat, patterns, replacements);
-
-            log_debug("sending rule for \n %s", name.c_str());
-            log_debug("rule: %s", rule.c_str());
-            result &= sendNewRule(rule, client);
+            RenderedRule r;
+            r.templat  = templat->name();
+            r.rule     = templat->instantiate(replacements);
+            r.hash     = std::hash<std::string>()(r.rule);
+            r.flexible = templat->flexible();
+
+            auto previous = generated.find(r.templat);
+            r.changed     = (previous == generated.end() || previous->second.hash != r.hash);
+            if (previous == generated.end() || previous->second.name.empty()) {
+                // parsing is the expensive part of sending, do it here rather than in apply()
+                if (RuleChannel::bound(ruleDestination(r.flexible))) {
+                    std::istringstream f(r.rule);
+                    if (readRule(f, r.parsed) != 0) {
+                        r.parsed.reset();
+                    }
+                }
+                r.name = r.parsed ? r.parsed->name() : ruleName(r.rule);
+            }
+            rendered.push_back(std::move(r));
         }
-
-        return result;
+        return true;
     } else if (streq(info.operation.c_str(), FTY_PROTO_ASSET_OP_DELETE) ||
                streq(info.operation.c_str(), FTY_PROTO_ASSET_OP_RETIRE) ||
                streq(info.operation.c_str(), FTY_PROTO_ASSET_OP_INVENTORY)) {
@@ -226,7 +374,81 @@ TemplateRuleConfigurator::configure (
         log_error("Unknown operation '%s' on asset '%s'", info.operation.c_str(), name.c_str());
     }
 
-    return true;
+    return false;
+}
+
+void TemplateRuleConfigurator::render(std::vector<DueDevice>& due, size_t workers)
+{
+    std::atomic<size_t> next{0};
+    auto                worker = [&]() {
+        for (size_t i = next++; i < due.size(); i = next++) {
+            DueDevice& device = due[i];
+            if (device.applicable) {
+                device.rendered_ok = render(
+                    device.it->first, device.it->second, device.ename_la, *device.generated, device.rendered);
+            }
+        }
+    };
+
+    if (workers == 0) {
+        workers = 1;
+        if (due.size() >= RENDER_PARALLEL_MIN_DEVICES) {
+            workers = std::max(1u, std::min(RENDER_WORKERS, std::thread::hardware_concurrency()));
+        }
+    }
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < workers; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+bool TemplateRuleConfigurator::apply(
+    const std::string& name, RenderedRules& rendered, mlm_client_t* client, GeneratedRules& generated)
+{
+    bool           result = true;
+    GeneratedRules current;
+
+    for (auto& r : rendered) {
+        auto previous = generated.find(r.templat);
+        if (previous != generated.end() && !previous->second.name.empty()) {
+            // user may have edited the thresholds of the rule, a new template or asset name doesn't replace it
+            log_debug("rule %s for %s %s, not sending it", previous->second.name.c_str(), name.c_str(),
+                r.changed ? "exists already" : "unchanged");
+            current.insert(*previous);
+            continue;
+        }
+
+        log_debug("sending rule for \n %s", name.c_str());
+        log_debug("rule: %s", r.rule.c_str());
+        const char* dest = ruleDestination(r.flexible);
+        bool        sent = sendNewRule(r.rule, dest, r.parsed, client);
+        if (sent) {
+            GeneratedRule& generatedRule = current[r.templat];
+            generatedRule.hash           = r.hash;
+            generatedRule.name           = r.name;
+            generatedRule.dest           = dest;
+        }
+        result &= sent;
+    }
+
+    // rules of templates which don't apply anymore
+    for (const auto& previous : generated) {
+        if (current.count(previous.first) != 0 || previous.second.name.empty()) {
+            continue;
+        }
+        log_debug("rule %s for %s no longer applies, deleting it", previous.second.name.c_str(), name.c_str());
+        if (!sendDeleteRule(previous.second, client)) {
+            current.insert(previous); // try again next time
+            result = false;
+        }
+    }
+    generated = std::move(current);
+
+    return result;
 }
 
 bool TemplateRuleConfigurator::isModelOk(const std::string& model, const std::string& templat)
@@ -241,9 +463,9 @@ bool TemplateRuleConfigurator::isApplicable(const AutoConfigurationInfo& info)
 
 bool TemplateRuleConfigurator::isApplicable(const AutoConfigurationInfo& info, const std::string& templat_name)
 {
-    cxxtools::Directory d(Autoconfig::RuleFilePath);
-    std::ifstream f(d.path() + "/" + templat_name);
-    if (!f.good())
+    auto                templates = RuleTemplateCache::get();
+    const RuleTemplate* templat   = templates->find(templat_name);
+    if (!templat)
         return false; // bad file
 
     std::string type_name = convertTypeSubType2Name(info.type.c_str(),info.subtype.c_str());
@@ -254,84 +476,41 @@ bool TemplateRuleConfigurator::isApplicable(const AutoConfigurationInfo& info, c
     {
         std::string model = info.attributes.find("model")->second;
         //for sensor gpio, we need to parse the template content to check model
-        std::string templat_content((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
-        if (templat_content.find(model) == std::string::npos)
+        if (templat->text().find(model) == std::string::npos)
             return false; // model not found
     }
 
     return true;
 }
 
-std::vector<std::string> TemplateRuleConfigurator::loadTemplates(const char* type, const char* subtype, bool fast_track)
-{
-    std::vector<std::string> templates;
-    if (!cxxtools::Directory::exists(Autoconfig::RuleFilePath.c_str())) {
-        log_info("TemplateRuleConfigurator '%s' dir does not exist", Autoconfig::RuleFilePath.c_str());
-        return templates;
-    }
-    std::string         type_name = convertTypeSubType2Name(type, subtype);
-    cxxtools::Directory d(Autoconfig::RuleFilePath);
-    for (const auto& fn : d) {
-        if (fn.find(type_name.c_str()) != std::string::npos) {
-
-            if (fast_track) {
-                if (fn == "realpower.default@__datacenter__.rule") {
-                    log_debug("match %s but not use for fast track", fn.c_str());
-                    continue;
-                }
-            }
-
-            log_debug("match %s", fn.c_str());
-
-            // read the template rule from the file
-            std::ifstream f(d.path() + "/" + fn);
-            std::string   str((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
-            templates.push_back(str);
-        }
-    }
-    return templates;
-}
-
 std::vector<std::pair<std::string, std::string>> TemplateRuleConfigurator::loadAllTemplates()
 {
     std::vector<std::pair<std::string, std::string>> templates;
-    if (!cxxtools::Directory::exists(Autoconfig::RuleFilePath.c_str())) {
+    auto                                             cached = RuleTemplateCache::get();
+    if (!cached->exists()) {
         log_info("TemplateRuleConfigurator '%s' dir does not exist", Autoconfig::RuleFilePath.c_str());
         return templates;
     }
-    cxxtools::Directory d(Autoconfig::RuleFilePath);
-    log_info("load all templates from %s", d.path().c_str());
-    for (const auto& fn : d) {
-        if (fn.compare(".") != 0 && fn.compare("..") != 0) {
-            try {
-                // read the template rule from the file
-                std::ifstream f(d.path() + "/" + fn);
-                std::string   str((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
-                templates.push_back(std::make_pair(fn, str));
-            } catch (const std::exception& e) {
-                log_error("error loading %s/%s (e: %s)", d.path().c_str(), fn.c_str(), e.what());
-            }
-        }
+    for (const auto& templat : cached->all()) {
+        templates.push_back(std::make_pair(templat.name(), templat.text()));
     }
     return templates;
 }
 
 bool TemplateRuleConfigurator::checkTemplate(const char* type, const char* subtype)
 {
-    if (!cxxtools::Directory::exists(Autoconfig::RuleFilePath)) {
+    auto templates = RuleTemplateCache::get();
+    if (!templates->exists()) {
         log_warning("TemplateRuleConfigurator '%s' dir does not exist", Autoconfig::RuleFilePath.c_str());
         return false;
     }
 
     std::string type_name = convertTypeSubType2Name(type, subtype);
 
-    cxxtools::Directory d(Autoconfig::RuleFilePath);
-    for (const auto& fName : d) {
-        log_trace("Template name is '%s'", fName.c_str());
-        if (fName.find(type_name.c_str()) != std::string::npos) {
-            log_debug("Using template '%s'", fName.c_str());
-            return true;
-        }
+    const auto& matching = templates->ofType(type_name);
+    if (!matching.empty()) {
+        log_debug("Using template '%s'", matching.front()->name().c_str());
+        return true;
     }
     return false;
 }
@@ -351,22 +530,3 @@ std::string TemplateRuleConfigurator::convertTypeSubType2Name(const char* type,
     //        type, subtype,name.c_str());
     return name;
 }
-
-std::string TemplateRuleConfigurator::replaceTokens(const std::string& text, const std::vector<std::string>& patterns,
-    const std::vector<std::string>& replacements) const
-{
-    assert(patterns.size() == replacements.size());
-    int         i      = 0;
-    std::string result = text;
-
-    for (auto& p : patterns) {
-        size_t pos = 0;
-        while ((pos = result.find(p, pos)) != std::string::npos) {
-            result.replace(pos, p.length(), replacements.at(fty::convert<size_t>(i)));
-            pos += replacements.at(fty::convert<size_t>(i)).length();
-        }
-        ++i;
-    }
-
-    return result;
-}
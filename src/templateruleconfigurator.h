@@ -21,13 +21,44 @@
 
 #pragma once
 
+#include "rule.h"
 #include "ruleconfigurator.h"
 #include <fstream>
+#include <map>
 #include <string>
+#include <vector>
 
 // PQSWMBT-4921 Xphase rule exceptions
 extern bool gDisable_ruleXphaseIsApplicable; // to pass selftest
 bool ruleXphaseIsApplicable(const std::string& ruleName, const AutoConfigurationInfo& assetInfo);
+bool isXphaseRule(const std::string& ruleName);      // rule is subject to ruleXphaseIsApplicable
+// phase count which ruleXphaseIsApplicable compares is known (1 or 3), e.g. not before metrics are in SHM
+bool ruleXphaseIsKnown(const std::string& ruleName, const AutoConfigurationInfo& assetInfo);
+void ruleXphaseInvalidate(const std::string& asset); // forget phases of asset read from SHM
+
+/// Rule generated from a template for a device, not sent yet
+struct RenderedRule
+{
+    std::string templat;          // template name
+    std::string rule;             // rule content
+    uint64_t    hash     = 0;     // std::hash of rule
+    bool        flexible = false; // rule is for fty-alert-flexible, see RuleTemplate::flexible()
+    bool        changed  = false; // rule differs from the generated one of the template (or there is none)
+    std::string name;             // rule name, read for new rules only
+    RulePtr     parsed;           // new rule parsed for the engine of this process, see RuleChannel
+};
+typedef std::vector<RenderedRule> RenderedRules;
+
+/// Device due for configuration in one Autoconfig::onPoll() round
+struct DueDevice
+{
+    std::map<std::string, AutoConfigurationInfo>::iterator it; // name | device
+    bool                                                   applicable = false;
+    std::string                                            ename_la;              // logical asset
+    GeneratedRules*                                        generated   = nullptr; // rules sent for the device so far
+    bool                                                   rendered_ok = false;   // render() generated rules
+    RenderedRules                                          rendered;
+};
 
 class TemplateRuleConfigurator : public RuleConfigurator
 {
@@ -35,16 +66,31 @@ public:
     using RuleConfigurator::configure;
     bool configure(const std::string& name, const AutoConfigurationInfo& info, const std::string& logical_asset,
         mlm_client_t* client);
+    /// Sends only rules which are new or no longer applicable compared to generated, existing ones are kept
+    /// @param[in,out] generated - rules sent for the device by the previous call, updated to the sent ones
+    bool configure(const std::string& name, const AutoConfigurationInfo& info, const std::string& logical_asset,
+        mlm_client_t* client, GeneratedRules& generated);
+    /// Generates rules of the device without sending them, safe to call from several threads at once
+    /// @param[in] generated - rules sent for the device so far
+    /// @param[out] rendered - rules to pass to apply()
+    /// @return false when the asset operation doesn't generate rules or templates can't be read
+    bool render(const std::string& name, const AutoConfigurationInfo& info, const std::string& logical_asset,
+        const GeneratedRules& generated, RenderedRules& rendered);
+    /// Generates rules of the applicable due devices, on several threads when there are many of them (asset import)
+    /// @param[in] workers - number of threads, 0 to choose by the number of devices
+    void render(std::vector<DueDevice>& due, size_t workers = 0);
+    /// Sends rendered rules which are new and deletes the ones no longer applicable, existing rules are kept as they
+    /// are (the user may have edited them)
+    /// @param[in,out] generated - rules sent for the device so far, updated to the sent ones
+    bool apply(const std::string& name, RenderedRules& rendered, mlm_client_t* client, GeneratedRules& generated);
     bool isApplicable(const AutoConfigurationInfo& info);
     bool isApplicable(const AutoConfigurationInfo& info, const std::string& templat_name);
     std::vector<std::pair<std::string, std::string>> loadAllTemplates();
+    /// Part of template names matching type and subtype (e.g. __device_ups__)
+    static std::string convertTypeSubType2Name(const char* type, const char* subtype);
     virtual ~TemplateRuleConfigurator(){};
 
 private:
-    bool                     checkTemplate(const char* type, const char* subtype);
-    std::vector<std::string> loadTemplates(const char* type, const char* subtype, bool fast_track = false);
-    std::string              convertTypeSubType2Name(const char* type, const char* subtype);
-    std::string              replaceTokens(const std::string& text, const std::vector<std::string>& patterns,
-                     const std::vector<std::string>& replacements) const;
-    bool                     isModelOk(const std::string& model, const std::string& templat);
+    bool checkTemplate(const char* type, const char* subtype);
+    bool isModelOk(const std::string& model, const std::string& templat);
 };
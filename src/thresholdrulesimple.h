@@ -21,6 +21,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 /// @brief Simple threshold rule representation
 #pragma once
 
+#include "debuglog.h"
 #include "rule.h"
 #include <cxxtools/serializationinfo.h>
 #include <fty_log.h>
@@ -158,7 +159,8 @@ public:
         // TODO actions
         pureAlert = PureAlert(
             ALERT_RESOLVED, metricList.getLastMetric().getTimestamp(), "ok", this->_element, this->_rule_class);
-        pureAlert.print();
+        if (log_debug_enabled())
+            pureAlert.print();
         return 0;
     };
 
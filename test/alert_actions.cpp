@@ -1,6 +1,10 @@
 #include "src/fty_alert_actions.h"
+#include "src/clock.h"
+#include "src/notificationoutbox.h"
 #include <catch2/catch.hpp>
 #include <fty_log.h>
+#include <string>
+#include <vector>
 
 #define TEST_ASSETS "ASSETS-TEST"
 #define TEST_ALERTS "ALERTS-TEST"
@@ -100,6 +104,324 @@ int testing = 0;
 TEST_VARS
 TEST_FUNCTIONS
 
+// requests sent by the actor instead of the requestreply client, the actor is not connected to malamute
+struct FakeRequest
+{
+    std::string address;
+    std::string subject;
+    std::string uuid;
+    std::string payload;
+};
+static std::vector<FakeRequest> fakeRequests;
+static int                      fakeSendResult = 0;
+
+static int s_fake_send(fty_alert_actions_t* /* self */, const char* address, const char* subject, zmsg_t** msg_p)
+{
+    if (fakeSendResult != 0) {
+        return fakeSendResult;
+    }
+    if (streq(subject, "ASSET_DETAIL")) {
+        char* cmd = zmsg_popstr(*msg_p);
+        CHECK(streq(cmd, "GET"));
+        zstr_free(&cmd);
+    }
+    // correlation id | frames of the request joined with '|'
+    char*       uuid = zmsg_popstr(*msg_p);
+    std::string payload;
+    for (char* frame = zmsg_popstr(*msg_p); frame; frame = zmsg_popstr(*msg_p)) {
+        payload += payload.empty() ? frame : std::string("|") + frame;
+        zstr_free(&frame);
+    }
+    fakeRequests.push_back({address, subject, uuid ? uuid : "", payload});
+    zstr_free(&uuid);
+    zmsg_destroy(msg_p);
+    return 0;
+}
+
+static void s_deliver_alert(
+    fty_alert_actions_t* self, const char* rule, const char* asset, const char* severity, const char* action = NULL)
+{
+    zlist_t* actions = zlist_new();
+    zlist_autofree(actions);
+    if (action) {
+        zlist_append(actions, const_cast<char*>(action));
+    }
+    zmsg_t* msg = fty_proto_encode_alert(
+        NULL, Clock::time(), 600, rule, asset, "ACTIVE", severity, "ASDFKLHJH", actions);
+    zlist_destroy(&actions);
+    REQUIRE(msg);
+    s_handle_stream_deliver(self, &msg, "");
+}
+
+TEST_CASE("alert actions asset requests")
+{
+    fakeRequests.clear();
+    fakeSendResult = 0;
+
+    // alert for unknown asset is parked until ASSET_DETAIL reply arrives
+    {
+        fty_alert_actions_t* self = fty_alert_actions_new();
+        REQUIRE(self);
+        self->requestreply_send = s_fake_send;
+
+        s_deliver_alert(self, "SOME_RULE", "myasset-4", "CRITICAL");
+        // second alert about the same asset shares the request
+        s_deliver_alert(self, "OTHER_RULE", "myasset-4", "WARNING");
+
+        REQUIRE(fakeRequests.size() == 1);
+        CHECK(fakeRequests[0].address == "asset-agent");
+        CHECK(fakeRequests[0].subject == "ASSET_DETAIL");
+        CHECK(fakeRequests[0].payload == "myasset-4");
+        CHECK(self->alerts_cache->by_rule.size() == 0);
+        REQUIRE(zhash_size(self->pending_requests) == 1);
+        s_pending_asset* pending = static_cast<s_pending_asset*>(zhash_first(self->pending_assets));
+        REQUIRE(pending);
+        CHECK(fakeRequests[0].uuid == pending->uuid);
+        CHECK(zlist_size(pending->alerts) == 2);
+
+        // reply with unknown correlation id is ignored
+        zmsg_t* resp_msg = fty_proto_encode_asset(NULL, "myasset-4", FTY_PROTO_ASSET_OP_UPDATE, NULL);
+        REQUIRE(resp_msg);
+        zmsg_pushstr(resp_msg, "unknown-uuid");
+        s_handle_requestreply_deliver(self, &resp_msg);
+        CHECK(resp_msg == NULL);
+        CHECK(zhash_size(self->pending_requests) == 1);
+
+        resp_msg = fty_proto_encode_asset(NULL, "myasset-4", FTY_PROTO_ASSET_OP_UPDATE, NULL);
+        REQUIRE(resp_msg);
+        zmsg_pushstr(resp_msg, fakeRequests[0].uuid.c_str());
+        s_handle_requestreply_deliver(self, &resp_msg);
+
+        CHECK(zhash_size(self->pending_requests) == 0);
+        CHECK(zhash_size(self->pending_assets) == 0);
+        CHECK(self->assets_cache->by_name.size() == 1);
+        CHECK(self->alerts_cache->by_rule.size() == 2);
+        REQUIRE(self->alerts_cache->by_asset.count("myasset-4") == 1);
+        CHECK(self->alerts_cache->by_asset.at("myasset-4").size() == 2);
+
+        // known asset needs no request
+        s_deliver_alert(self, "THIRD_RULE", "myasset-4", "WARNING");
+        CHECK(fakeRequests.size() == 1);
+        CHECK(self->alerts_cache->by_rule.size() == 3);
+
+        // deleting the asset drops its alerts and their index entry
+        zmsg_t* msg = fty_proto_encode_asset(NULL, "myasset-4", FTY_PROTO_ASSET_OP_DELETE, NULL);
+        REQUIRE(msg);
+        s_handle_stream_deliver(self, &msg, "");
+        CHECK(self->assets_cache->by_name.empty());
+        CHECK(self->alerts_cache->by_rule.empty());
+        CHECK(self->alerts_cache->by_asset.empty());
+
+        fty_alert_actions_destroy(&self);
+    }
+
+    // asset unknown to fty-asset, parked alerts are dropped
+    {
+        fakeRequests.clear();
+        fty_alert_actions_t* self = fty_alert_actions_new();
+        REQUIRE(self);
+        self->requestreply_send = s_fake_send;
+
+        s_deliver_alert(self, "SOME_RULE", "myasset-5", "CRITICAL");
+        REQUIRE(fakeRequests.size() == 1);
+
+        zmsg_t* resp_msg = zmsg_new();
+        zmsg_addstr(resp_msg, fakeRequests[0].uuid.c_str());
+        zmsg_addstr(resp_msg, "ERROR");
+        zmsg_addstr(resp_msg, "NOT_FOUND");
+        s_handle_requestreply_deliver(self, &resp_msg);
+        CHECK(resp_msg == NULL);
+        CHECK(zhash_size(self->pending_requests) == 0);
+        CHECK(zhash_size(self->pending_assets) == 0);
+        CHECK(self->assets_cache->by_name.empty());
+        CHECK(self->alerts_cache->by_rule.empty());
+
+        fty_alert_actions_destroy(&self);
+    }
+
+    // request can't be sent, the alert is dropped and nothing stays pending
+    {
+        fakeRequests.clear();
+        fakeSendResult            = -1;
+        fty_alert_actions_t* self = fty_alert_actions_new();
+        REQUIRE(self);
+        self->requestreply_send = s_fake_send;
+
+        s_deliver_alert(self, "SOME_RULE", "myasset-6", "CRITICAL");
+        CHECK(fakeRequests.empty());
+        CHECK(zhash_size(self->pending_requests) == 0);
+        CHECK(zhash_size(self->pending_assets) == 0);
+        CHECK(self->alerts_cache->by_rule.empty());
+
+        // next alert tries again
+        fakeSendResult = 0;
+        s_deliver_alert(self, "SOME_RULE", "myasset-6", "CRITICAL");
+        CHECK(fakeRequests.size() == 1);
+        CHECK(zhash_size(self->pending_assets) == 1);
+
+        fty_alert_actions_destroy(&self);
+    }
+
+    // unanswered request is given up after requestreply_timeout, on a fake clock
+    {
+        fakeRequests.clear();
+        FakeClock            clock(1600000000000);
+        fty_alert_actions_t* self = fty_alert_actions_new();
+        REQUIRE(self);
+        self->requestreply_send    = s_fake_send;
+        self->requestreply_timeout = 1000;
+
+        s_deliver_alert(self, "SOME_RULE", "myasset-7", "CRITICAL");
+        REQUIRE(zhash_size(self->pending_assets) == 1);
+
+        clock.advance(999);
+        check_pending_asset_requests(self, static_cast<uint64_t>(Clock::mono()));
+        CHECK(zhash_size(self->pending_assets) == 1);
+
+        clock.advance(1);
+        check_pending_asset_requests(self, static_cast<uint64_t>(Clock::mono()));
+        CHECK(zhash_size(self->pending_assets) == 0);
+        CHECK(zhash_size(self->pending_requests) == 0);
+        CHECK(self->alerts_cache->by_rule.empty());
+
+        // late reply is ignored
+        zmsg_t* resp_msg = fty_proto_encode_asset(NULL, "myasset-7", FTY_PROTO_ASSET_OP_UPDATE, NULL);
+        REQUIRE(resp_msg);
+        zmsg_pushstr(resp_msg, fakeRequests[0].uuid.c_str());
+        s_handle_requestreply_deliver(self, &resp_msg);
+        CHECK(self->assets_cache->by_name.empty());
+        CHECK(self->alerts_cache->by_rule.empty());
+
+        fty_alert_actions_destroy(&self);
+    }
+}
+
+TEST_CASE("alert actions notifications")
+{
+    fakeRequests.clear();
+    fakeSendResult = 0;
+
+    // alerts for the same contact are sent one by one, newer state of the same alert supersedes the unsent one
+    {
+        FakeClock            clock(1600000000000);
+        fty_alert_actions_t* self = fty_alert_actions_new();
+        REQUIRE(self);
+        self->requestreply_send = s_fake_send;
+        fty_proto_t* asset      = fty_proto_new(FTY_PROTO_ASSET);
+        REQUIRE(asset);
+        fty_proto_set_name(asset, "myasset-8");
+        fty_proto_ext_insert(asset, "contact_email", "%s", "admin@example.com");
+        fty_proto_ext_insert(asset, "name", "%s", "My Asset");
+        fty_proto_aux_insert(asset, "priority", "%s", "2");
+        s_asset_record* record = update_asset_record(self, asset);
+        fty_proto_destroy(&asset);
+        // the record owns its strings, nothing refers to the message
+        CHECK(record->ext_name == "My Asset");
+        CHECK(record->priority_str == "2");
+
+        s_deliver_alert(self, "SOME_RULE", "myasset-8", "WARNING", "EMAIL");
+        s_deliver_alert(self, "OTHER_RULE", "myasset-8", "WARNING", "EMAIL");
+        s_deliver_alert(self, "SOME_RULE", "myasset-8", "CRITICAL", "EMAIL");
+        self->outbox->dispatch(static_cast<uint64_t>(Clock::mono()));
+        CHECK(fakeRequests.empty());
+        CHECK(self->outbox->queued() == 2);
+
+        clock.advance(1000);
+        self->outbox->dispatch(static_cast<uint64_t>(Clock::mono()));
+        REQUIRE(fakeRequests.size() == 2);
+        for (const auto& request : fakeRequests) {
+            CHECK(request.address == "fty-email");
+            CHECK(request.subject == "SENDMAIL_ALERT");
+            // priority | ename | contact | alert
+            CHECK(request.payload.compare(0, 29, "2|My Asset|admin@example.com|") == 0);
+        }
+        CHECK(self->outbox->inFlight() == 2);
+        CHECK(self->outbox->queued() == 0);
+
+        fty_alert_actions_destroy(&self);
+    }
+
+    // notification is repeated after interval passed, alert is resolved after ttl passed since it was last received
+    {
+        fakeRequests.clear();
+        FakeClock            clock(1600000000000);
+        fty_alert_actions_t* self = fty_alert_actions_new();
+        REQUIRE(self);
+        self->requestreply_send = s_fake_send;
+        fty_proto_t* asset      = fty_proto_new(FTY_PROTO_ASSET);
+        REQUIRE(asset);
+        fty_proto_set_name(asset, "myasset-9");
+        fty_proto_ext_insert(asset, "contact_email", "%s", "admin@example.com");
+        fty_proto_aux_insert(asset, "priority", "%s", "1");
+        update_asset_record(self, asset);
+        fty_proto_destroy(&asset);
+
+        // CRITICAL alert of priority 1 asset is repeated every 5 minutes, its ttl is 600 s
+        const uint64_t start = static_cast<uint64_t>(Clock::mono());
+        auto           at    = [&clock, self, start](uint64_t ms) {
+            clock.advance(static_cast<int64_t>(start + ms - static_cast<uint64_t>(Clock::mono())));
+            check_alert_timers(self, static_cast<uint64_t>(Clock::mono()));
+            // sends everything queued so far
+            self->outbox->dispatch(static_cast<uint64_t>(Clock::mono()) + 1000);
+            return fakeRequests.size();
+        };
+        s_deliver_alert(self, "SOME_RULE", "myasset-9", "CRITICAL", "EMAIL");
+        CHECK(at(0) == 1);
+        CHECK(at(300000) == 1);
+        CHECK(at(300001) == 2);
+
+        // the same alert received again postpones its expiry, not the next notification
+        clock.advance(99999);
+        s_deliver_alert(self, "SOME_RULE", "myasset-9", "CRITICAL", "EMAIL");
+        CHECK(at(400000) == 2);
+        CHECK(at(600001) == 2);
+        CHECK(lookup_alert_cache_item(self, "SOME_RULE") != NULL);
+        CHECK(at(600002) == 3);
+
+        CHECK(at(1000000) == 4);
+        CHECK(lookup_alert_cache_item(self, "SOME_RULE") != NULL);
+        CHECK(at(1000001) == 4);
+        CHECK(lookup_alert_cache_item(self, "SOME_RULE") == NULL);
+        CHECK(self->alerts_cache->by_rule.empty());
+
+        fty_alert_actions_destroy(&self);
+    }
+
+    // changed severity sends the alert again and reschedules the repeat by its interval
+    {
+        fakeRequests.clear();
+        FakeClock            clock(1600000000000);
+        fty_alert_actions_t* self = fty_alert_actions_new();
+        REQUIRE(self);
+        self->requestreply_send = s_fake_send;
+        fty_proto_t* asset      = fty_proto_new(FTY_PROTO_ASSET);
+        REQUIRE(asset);
+        fty_proto_set_name(asset, "myasset-10");
+        fty_proto_ext_insert(asset, "contact_email", "%s", "admin@example.com");
+        fty_proto_aux_insert(asset, "priority", "%s", "1");
+        update_asset_record(self, asset);
+        fty_proto_destroy(&asset);
+
+        // WARNING is repeated every hour, CRITICAL every 5 minutes
+        s_deliver_alert(self, "SOME_RULE", "myasset-10", "WARNING", "EMAIL");
+        const uint64_t start = static_cast<uint64_t>(Clock::mono());
+        auto           at    = [&clock, self, start](uint64_t ms) {
+            clock.advance(static_cast<int64_t>(start + ms - static_cast<uint64_t>(Clock::mono())));
+            check_alert_timers(self, static_cast<uint64_t>(Clock::mono()));
+            self->outbox->dispatch(static_cast<uint64_t>(Clock::mono()) + 1000);
+            return fakeRequests.size();
+        };
+        CHECK(at(0) == 1);
+        clock.advance(10000);
+        s_deliver_alert(self, "SOME_RULE", "myasset-10", "CRITICAL", "EMAIL");
+        CHECK(at(10000) == 2);
+        CHECK(at(300000) == 2);
+        CHECK(at(300001) == 3);
+
+        fty_alert_actions_destroy(&self);
+    }
+}
+
 TEST_CASE("alert actions test", "[.]")
 {
     setenv("BIOS_LOG_PATTERN", "%D %c [%t] -%-5p- %M (%l) %m%n", 1);
@@ -119,48 +441,48 @@ TEST_CASE("alert actions test", "[.]")
     // test 2, check alert interval calculation
     {
         log_debug("test 2");
+        s_asset_record asset = {};
         s_alert_cache* cache = static_cast<s_alert_cache*>(malloc(sizeof(s_alert_cache)));
         cache->alert_msg     = fty_proto_new(FTY_PROTO_ALERT);
-        cache->related_asset = fty_proto_new(FTY_PROTO_ASSET);
+        cache->related_asset = &asset;
 
         fty_proto_set_severity(cache->alert_msg, "CRITICAL");
-        fty_proto_aux_insert(cache->related_asset, "priority", "%u", static_cast<unsigned int>(1));
+        cache->related_asset->priority = 1;
         CHECK(5 * 60 * 1000 == get_alert_interval(cache));
 
         fty_proto_set_severity(cache->alert_msg, "WARNING");
-        fty_proto_aux_insert(cache->related_asset, "priority", "%u", static_cast<unsigned int>(1));
+        cache->related_asset->priority = 1;
         CHECK(1 * 60 * 60 * 1000 == get_alert_interval(cache));
 
         fty_proto_set_severity(cache->alert_msg, "INFO");
-        fty_proto_aux_insert(cache->related_asset, "priority", "%u", static_cast<unsigned int>(1));
+        cache->related_asset->priority = 1;
         CHECK(8 * 60 * 60 * 1000 == get_alert_interval(cache));
 
         fty_proto_set_severity(cache->alert_msg, "CRITICAL");
-        fty_proto_aux_insert(cache->related_asset, "priority", "%u", static_cast<unsigned int>(3));
+        cache->related_asset->priority = 3;
         CHECK(15 * 60 * 1000 == get_alert_interval(cache));
 
         fty_proto_set_severity(cache->alert_msg, "WARNING");
-        fty_proto_aux_insert(cache->related_asset, "priority", "%u", static_cast<unsigned int>(3));
+        cache->related_asset->priority = 3;
         CHECK(4 * 60 * 60 * 1000 == get_alert_interval(cache));
 
         fty_proto_set_severity(cache->alert_msg, "INFO");
-        fty_proto_aux_insert(cache->related_asset, "priority", "%u", static_cast<unsigned int>(3));
+        cache->related_asset->priority = 3;
         CHECK(24 * 60 * 60 * 1000 == get_alert_interval(cache));
 
         fty_proto_set_severity(cache->alert_msg, "CRITICAL");
-        fty_proto_aux_insert(cache->related_asset, "priority", "%u", static_cast<unsigned int>(5));
+        cache->related_asset->priority = 5;
         CHECK(15 * 60 * 1000 == get_alert_interval(cache));
 
         fty_proto_set_severity(cache->alert_msg, "WARNING");
-        fty_proto_aux_insert(cache->related_asset, "priority", "%u", static_cast<unsigned int>(5));
+        cache->related_asset->priority = 5;
         CHECK(4 * 60 * 60 * 1000 == get_alert_interval(cache));
 
         fty_proto_set_severity(cache->alert_msg, "INFO");
-        fty_proto_aux_insert(cache->related_asset, "priority", "%u", static_cast<unsigned int>(5));
+        cache->related_asset->priority = 5;
         CHECK(24 * 60 * 60 * 1000 == get_alert_interval(cache));
 
         fty_proto_destroy(&cache->alert_msg);
-        fty_proto_destroy(&cache->related_asset);
         free(cache);
     }
 
@@ -171,45 +493,26 @@ TEST_CASE("alert actions test", "[.]")
         REQUIRE(self);
         fty_proto_t* asset = fty_proto_new(FTY_PROTO_ASSET);
         REQUIRE(asset);
-        zhash_insert(self->assets_cache, "myasset-3", asset);
+        fty_proto_set_name(asset, "myasset-3");
+        fty_proto_ext_insert(asset, "contact_email", "%s", "admin@example.com");
+        fty_proto_aux_insert(asset, "priority", "%u", static_cast<unsigned int>(2));
+        s_asset_record* record = update_asset_record(self, asset);
+        fty_proto_destroy(&asset);
+        CHECK(record->name == "myasset-3");
+        CHECK(record->contact_email == "admin@example.com");
+        CHECK(record->contact_sms == "");
+        CHECK(record->priority == 2);
+        CHECK(record->priority_str == "2");
         fty_proto_t* msg = fty_proto_new(FTY_PROTO_ALERT);
         REQUIRE(msg);
         fty_proto_set_name(msg, "myasset-3");
 
-        s_alert_cache* cache = new_alert_cache_item(self, msg);
-        CHECK(cache);
-        delete_alert_cache_item(cache);
-
-        fty_proto_destroy(&asset);
-        fty_alert_actions_destroy(&self);
-    }
-
-    // test 4, simple create/destroy cache item test with need to send ASSET_DETAILS
-    {
-        log_debug("test 4");
-        SET_UUID("uuid-test");
-        zhash_t* aux      = zhash_new();
-        zhash_t* ext      = zhash_new();
-        zmsg_t*  resp_msg = fty_proto_encode_asset(aux, "myasset-2", FTY_PROTO_ASSET_OP_UPDATE, ext);
-        zmsg_pushstr(resp_msg, GET_UUID);
-        REQUIRE(resp_msg);
-        INIT_RECV;
-        MSG_TO_RECV(resp_msg);
-        SET_SEND(0);
-        fty_alert_actions_t* self = fty_alert_actions_new();
-        REQUIRE(self);
-        fty_proto_t* msg = fty_proto_new(FTY_PROTO_ALERT);
-        CHECK(msg);
-        fty_proto_set_name(msg, "myasset-4");
-
         s_alert_cache* cache = new_alert_cache_item(self, msg);
         REQUIRE(cache);
+        CHECK(cache->related_asset == record);
         delete_alert_cache_item(cache);
 
         fty_alert_actions_destroy(&self);
-        zhash_destroy(&aux);
-        zhash_destroy(&ext);
-        CLEAN_RECV;
     }
 
     // test 5, processing of alerts from stream
@@ -242,8 +545,8 @@ TEST_CASE("alert actions test", "[.]")
         zclock_sleep(1000);
 
         // check the alert cache
-        CHECK(zhash_size(self->alerts_cache) == 1);
-        s_alert_cache* cached = static_cast<s_alert_cache*>(zhash_first(self->alerts_cache));
+        CHECK(self->alerts_cache->by_rule.size() == 1);
+        s_alert_cache* cached = self->alerts_cache->by_rule.begin()->second;
         fty_proto_t*   alert  = cached->alert_msg;
         CHECK(streq(fty_proto_rule(alert), "SOME_RULE"));
         CHECK(streq(fty_proto_name(alert), "SOME_ASSET"));
@@ -265,7 +568,7 @@ TEST_CASE("alert actions test", "[.]")
         zclock_sleep(1000);
 
         // alert cache is now empty
-        CHECK(zhash_size(self->alerts_cache) == 0);
+        CHECK(self->alerts_cache->by_rule.size() == 0);
         // clean up after
         fty_alert_actions_destroy(&self);
         zhash_destroy(&aux);
@@ -286,10 +589,9 @@ TEST_CASE("alert actions test", "[.]")
         zclock_sleep(1000);
 
         // check the assets cache
-        CHECK(zhash_size(self->assets_cache) == 1);
-        fty_proto_t* cached = static_cast<fty_proto_t*>(zhash_first(self->assets_cache));
-        CHECK(streq(fty_proto_operation(cached), FTY_PROTO_ASSET_OP_UPDATE));
-        CHECK(streq(fty_proto_name(cached), "SOME_ASSET"));
+        CHECK(self->assets_cache->by_name.size() == 1);
+        const s_asset_record& cached = self->assets_cache->by_name.begin()->second;
+        CHECK(cached.name == "SOME_ASSET");
 
         // delete asset
         msg = fty_proto_encode_asset(NULL, "SOME_ASSET", FTY_PROTO_ASSET_OP_DELETE, NULL);
@@ -299,7 +601,7 @@ TEST_CASE("alert actions test", "[.]")
         s_handle_stream_deliver(self, &msg, "");
         zclock_sleep(1000);
 
-        CHECK(zhash_size(self->assets_cache) == 0);
+        CHECK(self->assets_cache->by_name.size() == 0);
         fty_alert_actions_destroy(&self);
     }
     {
@@ -356,7 +658,7 @@ TEST_CASE("alert actions test", "[.]")
         zclock_sleep(1000);
 
         //      4. check that alert disappeared
-        CHECK(zhash_size(self->alerts_cache) == 0);
+        CHECK(self->alerts_cache->by_rule.size() == 0);
         fty_alert_actions_destroy(&self);
         CLEAN_RECV;
     }
@@ -7,6 +7,7 @@
 #include <iostream>
 #include <fstream>
 #include <filesystem>
+#include <cmath>
 
 TEST_CASE("audit-test")
 {
@@ -86,3 +87,100 @@ TEST_CASE("audit-test")
     printf(" * audit-test : OK\n");
 }
 
+TEST_CASE("audit-async-test")
+{
+    std::string LOG_CONFIG_FILE = "./test/audit/fty-alert-engine-log-test.cfg";
+    std::string LOG_OUTPUT_FILE = "/tmp/alarms-audit-test.log";
+
+    remove(LOG_OUTPUT_FILE.c_str());
+    AuditLogManager::init("alert-engine-test-audit-log", LOG_CONFIG_FILE);
+    AuditLogManager::startAsync(16);
+
+    uint32_t rule = AuditLogManager::ruleId("load@ups-1", {"load.input_L1@ups-1", "load.input_L2@ups-1"});
+    CHECK(AuditLogManager::ruleId("load@ups-1", {"load.input_L1@ups-1", "load.input_L2@ups-1"}) == rule);
+    CHECK(AuditLogManager::ruleId("load@ups-1", {"load.input_L1@ups-1"}) != rule);
+
+    // overflow the queue, records are dropped rather than blocking
+    const int NB_LOG = 10000;
+    for (int i = 0; i < NB_LOG; i++) {
+        AuditLogManager::audit(rule, {0.5, 42}, "ACTIVE", "CRITICAL");
+    }
+    AuditLogManager::audit(rule, {0.5, std::nan("")}, "UNKNOWN", "");
+
+    // deinit flushes the queue
+    AuditLogManager::deinit();
+
+    std::ifstream file(LOG_OUTPUT_FILE);
+    std::string   line;
+    int           written = 0;
+    bool          unknown = false;
+    while (std::getline(file, line)) {
+        if (line.find("Evaluate rule 'load@ups-1' [load.input_L1@ups-1 = 0.5, load.input_L2@ups-1 = 42] -> "
+                      "ACTIVE CRITICAL") != std::string::npos) {
+            written++;
+        }
+        if (line.find("[load.input_L1@ups-1 = 0.5, load.input_L2@ups-1 = NaN] -> UNKNOWN") != std::string::npos) {
+            unknown = true;
+        }
+    }
+    CHECK(written > 0);
+    CHECK(uint64_t(written) + AuditLogManager::dropped() + (unknown ? 1 : 0) == NB_LOG + 1);
+
+    remove(LOG_OUTPUT_FILE.c_str());
+}
+
+TEST_CASE("audit-release-test")
+{
+    std::string LOG_CONFIG_FILE = "./test/audit/fty-alert-engine-log-test.cfg";
+    std::string LOG_OUTPUT_FILE = "/tmp/alarms-audit-test.log";
+
+    remove(LOG_OUTPUT_FILE.c_str());
+    AuditLogManager::init("alert-engine-test-audit-log", LOG_CONFIG_FILE);
+    AuditLogManager::startAsync(16);
+    CHECK(AuditLogManager::dropped() == 0);
+
+    // the same rule loaded twice, released twice
+    uint32_t rule = AuditLogManager::ruleId("voltage@ups-1", {"voltage.input_L1@ups-1"});
+    AuditLogManager::audit(rule, {230}, "RESOLVED", "OK");
+    CHECK(AuditLogManager::ruleId("voltage@ups-1", {"voltage.input_L1@ups-1"}) == rule);
+    AuditLogManager::releaseRule(rule);
+    AuditLogManager::audit(rule, {240}, "ACTIVE", "WARNING");
+    AuditLogManager::releaseRule(rule);
+    AuditLogManager::releaseRule(rule);
+
+    // records queued before release are still written, the id is not reused
+    uint32_t again = AuditLogManager::ruleId("voltage@ups-1", {"voltage.input_L1@ups-1"});
+    CHECK(again != rule);
+    AuditLogManager::audit(again, {250}, "ACTIVE", "CRITICAL");
+    AuditLogManager::releaseRule(again);
+
+    AuditLogManager::deinit();
+
+    std::ifstream file(LOG_OUTPUT_FILE);
+    std::string   line;
+    int           written = 0;
+    while (std::getline(file, line)) {
+        for (const char* value : {"= 230] -> RESOLVED OK", "= 240] -> ACTIVE WARNING", "= 250] -> ACTIVE CRITICAL"}) {
+            if (line.find(std::string("Evaluate rule 'voltage@ups-1' [voltage.input_L1@ups-1 ") + value) !=
+                std::string::npos) {
+                written++;
+            }
+        }
+    }
+    CHECK(written == 3);
+
+    // released rule is forgotten in sync mode too
+    AuditLogManager::init("alert-engine-test-audit-log", LOG_CONFIG_FILE);
+    uint32_t sync = AuditLogManager::ruleId("voltage@ups-1", {"voltage.input_L1@ups-1"});
+    AuditLogManager::releaseRule(sync);
+    AuditLogManager::audit(sync, {260}, "ACTIVE", "CRITICAL");
+    AuditLogManager::deinit();
+
+    file.close();
+    file.open(LOG_OUTPUT_FILE);
+    while (std::getline(file, line)) {
+        CHECK(line.find("= 260]") == std::string::npos);
+    }
+
+    remove(LOG_OUTPUT_FILE.c_str());
+}
@@ -0,0 +1,230 @@
+#include <catch2/catch.hpp>
+#include <fty_proto.h>
+#include "src/autoconfig.h"
+#include "src/templateruleconfigurator.h"
+
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+typedef std::vector<std::pair<std::string, std::string>> Attributes;
+
+static fty_proto_t* s_asset(const char* operation, const Attributes& ext)
+{
+    fty_proto_t* asset = fty_proto_new(FTY_PROTO_ASSET);
+    REQUIRE(asset);
+    fty_proto_set_name(asset, "ups-1");
+    fty_proto_set_operation(asset, "%s", operation);
+    fty_proto_aux_insert(asset, "type", "%s", "device");
+    fty_proto_aux_insert(asset, "subtype", "%s", "ups");
+    fty_proto_aux_insert(asset, FTY_PROTO_ASSET_STATUS, "%s", "active");
+    for (const auto& it : ext) {
+        fty_proto_ext_insert(asset, it.first.c_str(), "%s", it.second.c_str());
+    }
+    return asset;
+}
+
+static uint64_t s_fingerprint(const char* operation, const Attributes& ext)
+{
+    fty_proto_t* asset       = s_asset(operation, ext);
+    uint64_t     fingerprint = assetFingerprint(asset);
+    fty_proto_destroy(&asset);
+    return fingerprint;
+}
+
+TEST_CASE("asset fingerprint")
+{
+    const Attributes ext = {{"name", "UPS 1"}, {"phases.input", "1"}, {"phases.output", "3"}, {"model", "9PX"}};
+    const uint64_t   fingerprint = s_fingerprint(FTY_PROTO_ASSET_OP_UPDATE, ext);
+
+    // the same asset republished, in any order of attributes
+    CHECK(s_fingerprint(FTY_PROTO_ASSET_OP_UPDATE, ext) == fingerprint);
+    CHECK(s_fingerprint(FTY_PROTO_ASSET_OP_UPDATE, {ext[3], ext[1], ext[0], ext[2]}) == fingerprint);
+
+    // one changed attribute
+    CHECK(s_fingerprint(FTY_PROTO_ASSET_OP_UPDATE, {ext[0], ext[1], {"phases.output", "1"}, ext[3]}) != fingerprint);
+    // values swapped between attributes
+    CHECK(s_fingerprint(FTY_PROTO_ASSET_OP_UPDATE, {ext[0], {"phases.input", "3"}, {"phases.output", "1"}, ext[3]}) !=
+          fingerprint);
+    // attribute added or removed
+    CHECK(s_fingerprint(FTY_PROTO_ASSET_OP_UPDATE, {ext[0], ext[1], ext[2], ext[3], {"location", "rack-1"}}) !=
+          fingerprint);
+    CHECK(s_fingerprint(FTY_PROTO_ASSET_OP_UPDATE, {ext[0], ext[1], ext[2]}) != fingerprint);
+    // other operation
+    CHECK(s_fingerprint(FTY_PROTO_ASSET_OP_CREATE, ext) != fingerprint);
+
+    // status change
+    fty_proto_t* asset = s_asset(FTY_PROTO_ASSET_OP_UPDATE, ext);
+    fty_proto_aux_insert(asset, FTY_PROTO_ASSET_STATUS, "%s", "nonactive");
+    CHECK(assetFingerprint(asset) != fingerprint);
+    fty_proto_destroy(&asset);
+}
+
+TEST_CASE("Xphase rules follow phases of the device")
+{
+    namespace fs = std::filesystem;
+
+    fs::path dir = fs::temp_directory_path() / "fty-alert-engine-xphase-test";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    for (const char* name : {"load.default", "voltage.input_1phase", "voltage.input_3phase"}) {
+        std::ofstream f(dir / (std::string(name) + "@__device_ups__.rule"));
+        f << "{\"single\":{\"rule_name\":\"" << name << "@__name__\",\"target\":[\"x@__name__\"]}}";
+    }
+    Autoconfig::RuleFilePath = dir.string();
+
+    bool disabled                   = gDisable_ruleXphaseIsApplicable;
+    gDisable_ruleXphaseIsApplicable = false;
+
+    AutoConfigurationInfo info;
+    info.type                       = "device";
+    info.subtype                    = "ups";
+    info.operation                  = FTY_PROTO_ASSET_OP_UPDATE;
+    info.attributes["phases.input"] = "1";
+
+    TemplateRuleConfigurator configurator;
+    GeneratedRules           generated;
+    RenderedRules            rendered;
+    auto                     templates = [&rendered]() {
+        std::map<std::string, bool> changed; // template | rule changed
+        for (const auto& r : rendered) {
+            changed[r.templat] = r.changed;
+        }
+        return changed;
+    };
+
+    // rule of the other phase count would be refused by the engine
+    REQUIRE(configurator.render("ups-1", info, "", generated, rendered));
+    CHECK(templates() ==
+          std::map<std::string, bool>{
+              {"load.default@__device_ups__.rule", true}, {"voltage.input_1phase@__device_ups__.rule", true}});
+    for (const auto& r : rendered) {
+        GeneratedRule& rule = generated[r.templat];
+        rule.hash           = r.hash;
+        rule.name           = r.name;
+        rule.dest           = "fty-alert-engine";
+    }
+    CHECK(generated["voltage.input_1phase@__device_ups__.rule"].name == "voltage.input_1phase@ups-1");
+
+    // the same device again, nothing to send
+    REQUIRE(configurator.render("ups-1", info, "", generated, rendered));
+    CHECK(templates() ==
+          std::map<std::string, bool>{
+              {"load.default@__device_ups__.rule", false}, {"voltage.input_1phase@__device_ups__.rule", false}});
+
+    // only phases changed, the 3 phase rule is new and the 1 phase one is left for apply() to delete
+    info.attributes["phases.input"] = "3";
+    REQUIRE(configurator.render("ups-1", info, "", generated, rendered));
+    CHECK(templates() ==
+          std::map<std::string, bool>{
+              {"load.default@__device_ups__.rule", false}, {"voltage.input_3phase@__device_ups__.rule", true}});
+    for (const auto& r : rendered) {
+        if (r.changed) {
+            generated[r.templat] = {r.hash, r.name, "fty-alert-engine"};
+        }
+    }
+    generated.erase("voltage.input_1phase@__device_ups__.rule");
+
+    // phase count unknown for a while, the rule generated before is kept rather than deleted
+    info.attributes.erase("phases.input");
+    REQUIRE(configurator.render("ups-1", info, "", generated, rendered));
+    CHECK(templates() ==
+          std::map<std::string, bool>{
+              {"load.default@__device_ups__.rule", false}, {"voltage.input_3phase@__device_ups__.rule", false}});
+
+    // rules are not generated without templates, nor deleted
+    Autoconfig::RuleFilePath = (dir / "missing").string();
+    CHECK(!configurator.render("ups-1", info, "", generated, rendered));
+
+    gDisable_ruleXphaseIsApplicable = disabled;
+    fs::remove_all(dir);
+}
+
+TEST_CASE("due devices are rendered")
+{
+    namespace fs = std::filesystem;
+
+    fs::path dir = fs::temp_directory_path() / "fty-alert-engine-render-test";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    {
+        std::ofstream f(dir / "load.default@__device_ups__.rule");
+        f << "{\"single\":{\"rule_name\":\"load.default@__name__\",\"target\":[\"x@__name__\"]}}";
+    }
+    Autoconfig::RuleFilePath = dir.string();
+
+    std::map<std::string, AutoConfigurationInfo> devices;
+    std::map<std::string, GeneratedRules>        generated;
+    std::vector<DueDevice>                       due;
+    for (int i = 1; i <= 40; i++) {
+        AutoConfigurationInfo info;
+        info.type      = "device";
+        info.subtype   = "ups";
+        info.operation = FTY_PROTO_ASSET_OP_CREATE;
+        devices["ups-" + std::to_string(i)] = info;
+    }
+    for (auto it = devices.begin(); it != devices.end(); ++it) {
+        DueDevice device;
+        device.it         = it;
+        device.applicable = (it->first != "ups-7");
+        device.generated  = &generated[it->first];
+        due.push_back(std::move(device));
+    }
+
+    TemplateRuleConfigurator configurator;
+    configurator.render(due, 4);
+    for (const auto& device : due) {
+        INFO(device.it->first);
+        if (device.it->first == "ups-7") {
+            CHECK(!device.rendered_ok);
+            CHECK(device.rendered.empty());
+        } else {
+            CHECK(device.rendered_ok);
+            REQUIRE(device.rendered.size() == 1);
+            CHECK(device.rendered[0].name == "load.default@" + device.it->first);
+        }
+    }
+
+    fs::remove_all(dir);
+}
+
+TEST_CASE("existing rules are not replaced")
+{
+    namespace fs = std::filesystem;
+
+    fs::path dir = fs::temp_directory_path() / "fty-alert-engine-existing-test";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    {
+        std::ofstream f(dir / "load.default@__device_ups__.rule");
+        f << "{\"single\":{\"rule_name\":\"load.default@__name__\",\"target\":[\"x@__name__\"],\"x\":\"__ename__\"}}";
+    }
+    Autoconfig::RuleFilePath = dir.string();
+
+    AutoConfigurationInfo info;
+    info.type               = "device";
+    info.subtype            = "ups";
+    info.operation          = FTY_PROTO_ASSET_OP_UPDATE;
+    info.attributes["name"] = "UPS renamed";
+
+    // rule generated for the former name, its thresholds may have been edited since
+    GeneratedRules generated;
+    generated["load.default@__device_ups__.rule"] = {42, "load.default@ups-1", "fty-alert-engine"};
+
+    TemplateRuleConfigurator configurator;
+    RenderedRules            rendered;
+    REQUIRE(configurator.render("ups-1", info, "", generated, rendered));
+    REQUIRE(rendered.size() == 1);
+    CHECK(rendered[0].changed);
+
+    // nothing is sent (there is no client to send it with)
+    CHECK(configurator.apply("ups-1", rendered, NULL, generated));
+    REQUIRE(generated.size() == 1);
+    CHECK(generated["load.default@__device_ups__.rule"].hash == 42);
+    CHECK(generated["load.default@__device_ups__.rule"].name == "load.default@ups-1");
+
+    fs::remove_all(dir);
+}
@@ -1421,6 +1421,46 @@ TEST_CASE("Alert engine server")
         fty_proto_destroy(&brecv);
     }
 
+    // Test case #31: evaluation statistics
+    {
+        zmsg_t* command = zmsg_new();
+        zmsg_addstr(command, "STATS");
+        zmsg_addstr(command, "time");
+        zmsg_addstr(command, "2");
+        mlm_client_sendto(ui, "fty-alert-engine", "rfc-evaluator-rules", NULL, 1000, &command);
+
+        zmsg_t* recv = mlm_client_recv(ui);
+        REQUIRE(zmsg_size(recv) == 5);
+        char* foo = zmsg_popstr(recv);
+        REQUIRE(streq(foo, "STATS"));
+        zstr_free(&foo);
+        foo = zmsg_popstr(recv);
+        REQUIRE(streq(foo, "time"));
+        zstr_free(&foo);
+        foo = zmsg_popstr(recv);
+        REQUIRE(strstr(foo, "\"cycles\"") != NULL);
+        zstr_free(&foo);
+        foo = zmsg_popstr(recv);
+        REQUIRE(strstr(foo, "\"evaluations\"") != NULL);
+        zstr_free(&foo);
+        zmsg_destroy(&recv);
+
+        command = zmsg_new();
+        zmsg_addstr(command, "STATS");
+        zmsg_addstr(command, "bogus");
+        mlm_client_sendto(ui, "fty-alert-engine", "rfc-evaluator-rules", NULL, 1000, &command);
+
+        recv = mlm_client_recv(ui);
+        REQUIRE(zmsg_size(recv) == 2);
+        foo = zmsg_popstr(recv);
+        REQUIRE(streq(foo, "ERROR"));
+        zstr_free(&foo);
+        foo = zmsg_popstr(recv);
+        REQUIRE(streq(foo, "INVALID_SORT"));
+        zstr_free(&foo);
+        zmsg_destroy(&recv);
+    }
+
     // utf8eq
     {
         static const std::vector<std::string> strings{"ŽlUťOUčKý kůň",
@@ -0,0 +1,31 @@
+#include <catch2/catch.hpp>
+#include "src/latencyhistogram.h"
+
+TEST_CASE("latency histogram")
+{
+    LatencyHistogram histogram;
+    CHECK(histogram.count() == 0);
+    CHECK(histogram.percentile(99) == 0);
+
+    for (uint64_t i = 1; i <= 100; i++) {
+        histogram.add(i);
+    }
+    CHECK(histogram.count() == 100);
+    CHECK(histogram.max() == 100);
+    // values are precise to a factor of two
+    CHECK(histogram.percentile(50) == 63);
+    CHECK(histogram.percentile(99) == 100);
+    CHECK(histogram.percentile(1) == 1);
+
+    LatencyHistogram other;
+    other.add(0);
+    other.add(100000);
+    histogram.merge(other);
+    CHECK(histogram.count() == 102);
+    CHECK(histogram.max() == 100000);
+    CHECK(histogram.percentile(100) == 100000);
+
+    histogram.reset();
+    CHECK(histogram.count() == 0);
+    CHECK(histogram.max() == 0);
+}
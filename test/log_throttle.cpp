@@ -0,0 +1,69 @@
+#include <catch2/catch.hpp>
+#include "src/logthrottle.h"
+
+TEST_CASE("log throttle")
+{
+    LogThrottle throttle(60000);
+    uint64_t    occurrences = 0, seconds = 0;
+
+    // first message goes through
+    CHECK(throttle.allow("ups-1", 1000, occurrences, seconds));
+    CHECK(occurrences == 1);
+    CHECK(seconds == 0);
+
+    // repeated ones are counted within the interval
+    CHECK(!throttle.allow("ups-1", 2000, occurrences, seconds));
+    CHECK(!throttle.allow("ups-1", 60999, occurrences, seconds));
+
+    // other keys are independent
+    CHECK(throttle.allow("ups-2", 3000, occurrences, seconds));
+    CHECK(throttle.size() == 2);
+
+    // next message after the interval carries the count
+    CHECK(throttle.allow("ups-1", 61000, occurrences, seconds));
+    CHECK(occurrences == 3);
+    CHECK(seconds == 60);
+
+    CHECK(!throttle.allow("ups-1", 62000, occurrences, seconds));
+    CHECK(throttle.allow("ups-1", 200000, occurrences, seconds));
+    CHECK(occurrences == 2);
+    CHECK(seconds == 139);
+
+    // keys which would be let through anyway are forgotten when there are too many
+    for (int i = 0; i < 5000; i++) {
+        throttle.allow("metric-" + std::to_string(i), 300000, occurrences, seconds);
+    }
+    CHECK(throttle.size() > 4096);
+    CHECK(throttle.allow("ups-3", 1000000, occurrences, seconds));
+    CHECK(throttle.size() == 1);
+}
+
+TEST_CASE("log throttle flush")
+{
+    LogThrottle throttle(60000);
+    uint64_t    occurrences = 0, seconds = 0;
+
+    CHECK(throttle.allow("ups-1", 1000, occurrences, seconds, "bad metric"));
+    CHECK(throttle.allow("ups-2", 1000, occurrences, seconds, "bad metric"));
+    CHECK(!throttle.allow("ups-1", 2000, occurrences, seconds, "bad metric"));
+    CHECK(!throttle.allow("ups-1", 3000, occurrences, seconds, "bad metric"));
+
+    // nothing before the interval
+    CHECK(throttle.flush(60999) == 0);
+    CHECK(throttle.size() == 2);
+
+    // suppressed occurrences are logged although the message does not come again,
+    // keys with nothing suppressed are forgotten
+    CHECK(throttle.flush(61000) == 1);
+    CHECK(throttle.size() == 1);
+
+    // counted from the summary
+    CHECK(!throttle.allow("ups-1", 62000, occurrences, seconds, "bad metric"));
+    CHECK(throttle.flush(100000) == 0);
+    CHECK(throttle.allow("ups-1", 121000, occurrences, seconds, "bad metric"));
+    CHECK(occurrences == 2);
+    CHECK(seconds == 60);
+
+    CHECK(throttle.flush(181000) == 0);
+    CHECK(throttle.size() == 0);
+}
@@ -0,0 +1,208 @@
+#include <catch2/catch.hpp>
+#include "src/clock.h"
+#include "src/fty_alert_engine_server.h"
+#include "src/metriclist.h"
+#include "src/metricrecording.h"
+
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static fty_proto_t* s_metric(const char* type, const char* name, const char* value, uint64_t time)
+{
+    RecordedMetric metric;
+    metric.type  = type;
+    metric.name  = name;
+    metric.value = value;
+    metric.unit  = "%";
+    metric.ttl   = 60;
+    metric.time  = time;
+    return metric.toProto();
+}
+
+TEST_CASE("metric recording")
+{
+    namespace fs = std::filesystem;
+
+    fs::path dir = fs::temp_directory_path() / "fty-alert-engine-metric-recording-test";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    const std::string file = (dir / "metrics.rec").string();
+
+    {
+        MetricRecorder recorder;
+        CHECK(!recorder.isOpen());
+        CHECK(recorder.open(file) == 0);
+
+        fty::shm::shmMetrics first;
+        first.add(s_metric("load.default", "ups-1", "42.5", 1600000000));
+        first.add(s_metric("load.default", "ups-2", "12", 0));
+        CHECK(recorder.snapshot(1600000001000, first) == 0);
+        CHECK(recorder.unavailable(1600000002500, "load.default@ups-2") == 0);
+
+        // names are known, only the values are written
+        auto size = fs::file_size(file);
+        fty::shm::shmMetrics second;
+        second.add(s_metric("load.default", "ups-1", "43", 1600000030));
+        CHECK(recorder.snapshot(1600000031000, second) == 0);
+        CHECK(fs::file_size(file) - size < 32);
+    }
+
+    MetricRecording recording;
+    MetricRecord    record;
+    CHECK(recording.open(file) == 0);
+
+    REQUIRE(recording.next(record));
+    CHECK(record.kind == MetricRecord::SNAPSHOT);
+    CHECK(record.time == 1600000001000);
+    REQUIRE(record.metrics.size() == 2);
+    CHECK(record.metrics[0].type == "load.default");
+    CHECK(record.metrics[0].name == "ups-1");
+    CHECK(record.metrics[0].value == "42.5");
+    CHECK(record.metrics[0].unit == "%");
+    CHECK(record.metrics[0].ttl == 60);
+    CHECK(record.metrics[0].time == 1600000000);
+    CHECK(record.metrics[1].name == "ups-2");
+    CHECK(record.metrics[1].time == 0);
+
+    REQUIRE(recording.next(record));
+    CHECK(record.kind == MetricRecord::UNAVAILABLE);
+    CHECK(record.time == 1600000002500);
+    CHECK(record.topic == "load.default@ups-2");
+
+    REQUIRE(recording.next(record));
+    CHECK(record.time == 1600000031000);
+    REQUIRE(record.metrics.size() == 1);
+    CHECK(record.metrics[0].name == "ups-1");
+    CHECK(record.metrics[0].value == "43");
+
+    fty_proto_t* metric = record.metrics[0].toProto();
+    CHECK(streq(fty_proto_type(metric), "load.default"));
+    CHECK(streq(fty_proto_value(metric), "43"));
+    CHECK(fty_proto_aux_number(metric, "time", 0) == 1600000030);
+    fty_proto_destroy(&metric);
+
+    CHECK(!recording.next(record));
+    CHECK(!recording.truncated());
+
+    // torn last record ends the replay
+    fs::resize_file(file, fs::file_size(file) - 3);
+    CHECK(recording.open(file) == 0);
+    CHECK(recording.next(record));
+    CHECK(recording.next(record));
+    CHECK(!recording.next(record));
+    CHECK(recording.truncated());
+
+    CHECK(recording.open((dir / "missing.rec").string()) == -1);
+
+    fs::remove_all(dir);
+}
+
+TEST_CASE("simulated clock")
+{
+    CHECK(!Clock::simulated());
+    uint64_t now = Clock::time();
+    CHECK(now > 1600000000);
+
+    Clock::simulate(1600000001500);
+    CHECK(Clock::simulated());
+    CHECK(Clock::time() == 1600000001);
+    CHECK(Clock::timeMs() == 1600000001500);
+    CHECK(Clock::mono() == 1600000001500);
+
+    Clock::real();
+    CHECK(!Clock::simulated());
+    CHECK(Clock::time() >= now);
+
+    // metrics expire at the cycle time, not when they are looked up
+    {
+        FakeClock  clock(1600000000000);
+        MetricList list;
+        list.addMetric(MetricInfo("ups-1", "load.default", "%", 42, Clock::time(), "", 60));
+        list.setTime(Clock::time());
+
+        clock.advance(61000);
+        CHECK(list.findAndCheck("load.default@ups-1") == 42);
+        list.removeOldMetrics();
+        CHECK(list.find("load.default@ups-1") == 42);
+
+        list.setTime(Clock::time());
+        CHECK(std::isnan(list.findAndCheck("load.default@ups-1")));
+        list.removeOldMetrics();
+        CHECK(std::isnan(list.find("load.default@ups-1")));
+    }
+    CHECK(!Clock::simulated());
+}
+
+TEST_CASE("metric replay")
+{
+    namespace fs = std::filesystem;
+
+    fs::path dir = fs::temp_directory_path() / "fty-alert-engine-metric-replay-test";
+    fs::remove_all(dir);
+    fs::create_directories(dir / "rules");
+    const std::string file = (dir / "metrics.rec").string();
+    {
+        // metric and element not used by other tests, rules of the engine may be loaded already
+        std::ofstream f(dir / "rules" / "replay_load@ups-r1.rule");
+        f << R"({"threshold":{"rule_name":"replay_load@ups-r1","target":"load.default@ups-r1","element":"ups-r1",)"
+          << R"("values":[{"low_critical":"10"},{"low_warning":"20"},{"high_warning":"80"},{"high_critical":"90"}],)"
+          << R"("results":[{"low_critical":{"action":[],"description":"load too low"}},)"
+          << R"({"low_warning":{"action":[],"description":"load low"}},)"
+          << R"({"high_warning":{"action":[],"description":"load high"}},)"
+          << R"({"high_critical":{"action":[],"description":"load too high"}}]}})";
+    }
+
+    {
+        MetricRecorder recorder;
+        REQUIRE(recorder.open(file) == 0);
+        for (const auto& it : std::vector<std::pair<uint64_t, const char*>>{
+                 {1600000000, "50"}, {1600000060, "85"}, {1600000120, "95"}}) {
+            fty::shm::shmMetrics metrics;
+            metrics.add(s_metric("load.default", "ups-r1", it.second, it.first));
+            CHECK(recorder.snapshot(int64_t(it.first) * 1000 + 500, metrics) == 0);
+        }
+        CHECK(recorder.unavailable(1600000150000, "load.default@ups-r1") == 0);
+        // alert is forgotten, nothing to resolve
+        fty::shm::shmMetrics metrics;
+        metrics.add(s_metric("load.default", "ups-r1", "50", 1600000180));
+        CHECK(recorder.snapshot(1600000180500, metrics) == 0);
+    }
+
+    ReplayStats stats;
+    FILE*       alerts = tmpfile();
+    REQUIRE(alerts);
+    clearEvaluateMetrics();
+    REQUIRE(replay_metrics(file.c_str(), (dir / "rules").string().c_str(), alerts, stats) == 0);
+    CHECK(!Clock::simulated());
+
+    rewind(alerts);
+    std::vector<std::string> lines;
+    char                     line[1024];
+    while (fgets(line, sizeof(line), alerts)) {
+        std::string text(line);
+        if (text.find("replay_load@ups-r1") != std::string::npos) {
+            lines.push_back(text);
+        }
+    }
+    fclose(alerts);
+
+    // time \t rule \t element \t status \t severity \t description
+    CHECK(lines == std::vector<std::string>{
+                       "1600000060\treplay_load@ups-r1\tups-r1\tACTIVE\tWARNING\tload high\n",
+                       "1600000120\treplay_load@ups-r1\tups-r1\tACTIVE\tCRITICAL\tload too high\n",
+                       "1600000150\treplay_load@ups-r1\tups-r1\tRESOLVED\tCRITICAL\tRule was changed implicitly\n"});
+
+    CHECK(stats.cycles == 4);
+    CHECK(stats.metrics == 4);
+    CHECK(stats.alerts == 3);
+    CHECK(stats.evaluations >= 4);
+    CHECK(!stats.truncated);
+
+    CHECK(replay_metrics((dir / "missing.rec").string().c_str(), (dir / "rules").string().c_str(), NULL, stats) == -1);
+
+    fs::remove_all(dir);
+}
@@ -0,0 +1,129 @@
+#include <catch2/catch.hpp>
+#include <fty_log.h>
+#include "src/notificationoutbox.h"
+
+#include <string>
+#include <vector>
+
+TEST_CASE("notification outbox")
+{
+    struct Sent
+    {
+        std::string address;
+        std::string subject;
+        std::string uuid;
+        std::string payload;
+    };
+    std::vector<Sent> sent;
+    int               sendResult = 0;
+
+    NotificationOutbox outbox(
+        [&sent, &sendResult](const std::string& address, const std::string& subject, zmsg_t** msg_p) {
+            if (sendResult != 0) {
+                return sendResult;
+            }
+            char* uuid    = zmsg_popstr(*msg_p);
+            char* payload = zmsg_popstr(*msg_p);
+            sent.push_back({address, subject, uuid, payload});
+            zstr_free(&uuid);
+            zstr_free(&payload);
+            zmsg_destroy(msg_p);
+            return 0;
+        },
+        /* replyTimeout */ 100, /* coalesceWindow */ 10, /* retryBackoff */ 20, /* maxAttempts */ 2,
+        /* maxInFlight */ 2);
+
+    auto enqueue = [&outbox](const std::string& key, const char* payload, uint64_t now) {
+        zmsg_t* msg = zmsg_new();
+        zmsg_addstr(msg, payload);
+        outbox.enqueue("fty-email", "SENDMAIL_ALERT", key, &msg, now);
+        CHECK(msg == NULL);
+    };
+    auto reply = [&outbox](const std::string& uuid, const char* status, uint64_t now) {
+        zmsg_t* msg = zmsg_new();
+        zmsg_addstr(msg, status);
+        bool handled = outbox.handleReply(uuid, &msg, now);
+        zmsg_destroy(&msg);
+        return handled;
+    };
+
+    SECTION("coalescing within the window")
+    {
+        enqueue("rule@asset", "ACTIVE", 0);
+        enqueue("rule@asset", "RESOLVED", 5);
+        CHECK(outbox.queued() == 1);
+        outbox.dispatch(5);
+        CHECK(sent.empty());
+        CHECK(outbox.timeToNext(5) == 5);
+        outbox.dispatch(10);
+        REQUIRE(sent.size() == 1);
+        CHECK(sent[0].payload == "RESOLVED");
+        CHECK(outbox.inFlight() == 1);
+        CHECK(reply(sent[0].uuid, "OK", 20));
+        CHECK(outbox.inFlight() == 0);
+        CHECK(!reply(sent[0].uuid, "OK", 20));
+        CHECK(outbox.timeToNext(20) == -1);
+    }
+
+    SECTION("in flight limit")
+    {
+        enqueue("a", "1", 0);
+        enqueue("b", "2", 0);
+        enqueue("c", "3", 0);
+        outbox.dispatch(10);
+        CHECK(sent.size() == 2);
+        CHECK(outbox.queued() == 1);
+        CHECK(reply(sent[0].uuid, "OK", 15));
+        outbox.dispatch(15);
+        REQUIRE(sent.size() == 3);
+        CHECK(sent[2].payload == "3");
+    }
+
+    SECTION("request without reply is not sent again")
+    {
+        enqueue("a", "1", 0);
+        outbox.dispatch(10);
+        CHECK(sent.size() == 1);
+        outbox.checkTimeouts(109);
+        CHECK(outbox.inFlight() == 1);
+        // recipients don't drop duplicates, the request may still be processed (slow SMTP server)
+        outbox.checkTimeouts(110);
+        CHECK(outbox.inFlight() == 0);
+        CHECK(outbox.queued() == 0);
+        outbox.dispatch(200);
+        CHECK(sent.size() == 1);
+        CHECK(!reply(sent[0].uuid, "OK", 240));
+        CHECK(outbox.timeToNext(240) == -1);
+
+        // newer state of the alert is sent
+        enqueue("a", "2", 250);
+        outbox.dispatch(260);
+        REQUIRE(sent.size() == 2);
+        CHECK(sent[1].uuid != sent[0].uuid);
+        CHECK(sent[1].payload == "2");
+    }
+
+    SECTION("failed send is retried")
+    {
+        sendResult = -1;
+        enqueue("a", "1", 0);
+        outbox.dispatch(10);
+        CHECK(outbox.queued() == 1);
+        CHECK(outbox.inFlight() == 0);
+        sendResult = 0;
+        outbox.dispatch(30);
+        CHECK(sent.size() == 1);
+        CHECK(reply(sent[0].uuid, "ERROR", 40));
+        CHECK(outbox.inFlight() == 0);
+        CHECK(outbox.queued() == 0);
+
+        // given up after the last attempt
+        sendResult = -1;
+        enqueue("b", "2", 50);
+        outbox.dispatch(60);
+        CHECK(outbox.queued() == 1);
+        outbox.dispatch(80);
+        CHECK(outbox.queued() == 0);
+        CHECK(outbox.timeToNext(80) == -1);
+    }
+}
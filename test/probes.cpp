@@ -0,0 +1,86 @@
+#include <catch2/catch.hpp>
+#include "src/probes.h"
+
+#include <cstring>
+#include <elf.h>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <string>
+
+// provider:name of the probes in .note.stapsdt of the ELF file, as listed by readelf -n
+static std::set<std::string> s_probes(const std::string& file)
+{
+    std::set<std::string> probes;
+
+    std::ifstream     f(file, std::ios::in | std::ios::binary);
+    const std::string elf((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    if (elf.size() < sizeof(Elf64_Ehdr) || elf.compare(0, SELFMAG, ELFMAG) != 0 || elf[EI_CLASS] != ELFCLASS64) {
+        return probes;
+    }
+
+    Elf64_Ehdr ehdr;
+    memcpy(&ehdr, elf.data(), sizeof(ehdr));
+    if (ehdr.e_shoff == 0 || ehdr.e_shstrndx >= ehdr.e_shnum ||
+        ehdr.e_shoff + uint64_t(ehdr.e_shnum) * sizeof(Elf64_Shdr) > elf.size()) {
+        return probes;
+    }
+    auto section = [&elf, &ehdr](size_t index) {
+        Elf64_Shdr shdr;
+        memcpy(&shdr, elf.data() + ehdr.e_shoff + index * sizeof(Elf64_Shdr), sizeof(shdr));
+        return shdr;
+    };
+    const Elf64_Shdr strtab = section(ehdr.e_shstrndx);
+
+    for (size_t i = 0; i < ehdr.e_shnum; i++) {
+        const Elf64_Shdr shdr = section(i);
+        if (shdr.sh_type != SHT_NOTE || strtab.sh_offset + shdr.sh_name >= elf.size() ||
+            strcmp(elf.c_str() + strtab.sh_offset + shdr.sh_name, ".note.stapsdt") != 0 ||
+            shdr.sh_offset + shdr.sh_size > elf.size()) {
+            continue;
+        }
+        // note: header | name "stapsdt" | desc: pc, base, semaphore (addresses) | provider | name | arguments
+        size_t pos = shdr.sh_offset;
+        size_t end = shdr.sh_offset + shdr.sh_size;
+        while (pos + sizeof(Elf64_Nhdr) <= end) {
+            Elf64_Nhdr nhdr;
+            memcpy(&nhdr, elf.data() + pos, sizeof(nhdr));
+            size_t name = pos + sizeof(nhdr);
+            size_t desc = name + ((nhdr.n_namesz + 3) & ~3u);
+            pos         = desc + ((nhdr.n_descsz + 3) & ~3u);
+            if (pos > end) {
+                break;
+            }
+            if (nhdr.n_type != 3 || nhdr.n_descsz <= 3 * sizeof(uint64_t) || strcmp(elf.c_str() + name, "stapsdt")) {
+                continue;
+            }
+            const std::string strings(elf.data() + desc + 3 * sizeof(uint64_t), nhdr.n_descsz - 3 * sizeof(uint64_t));
+            const char*       provider = strings.c_str();
+            const char*       probe    = provider + strlen(provider) + 1;
+            if (probe < strings.c_str() + strings.size()) {
+                probes.insert(std::string(provider) + ":" + probe);
+            }
+        }
+    }
+    return probes;
+}
+
+TEST_CASE("probes")
+{
+#ifdef FTY_ALERT_ENGINE_PROBES
+    // the test binary links the objects of the probed code, as the engine does
+    const std::set<std::string> probes = s_probes("/proc/self/exe");
+
+    for (const char* name : {"metric_ingest", "rule_evaluate_start", "rule_evaluate_end", "lua_call_start",
+             "lua_call_end", "alert_transition", "alert_publish", "mailbox_command_begin", "mailbox_command_end",
+             "notification_dispatch"}) {
+        INFO(name);
+        CHECK(probes.count(std::string("fty_alert_engine:") + name) == 1);
+    }
+#else
+    WARN("built without <sys/sdt.h> or with FTY_ALERT_ENGINE_NO_PROBES, probes are not compiled in");
+    for (const auto& probe : s_probes("/proc/self/exe")) {
+        CHECK(probe.compare(0, 17, "fty_alert_engine:") != 0);
+    }
+#endif
+}
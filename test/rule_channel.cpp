@@ -0,0 +1,53 @@
+#include <catch2/catch.hpp>
+#include <fty_log.h>
+#include "src/alertconfiguration.h"
+#include "src/rulechannel.h"
+
+#include <fstream>
+
+TEST_CASE("rule channel")
+{
+    const std::string dir("test/testrules/");
+    RulePtr           rule;
+    {
+        std::ifstream f(dir + "simplethreshold.rule");
+        REQUIRE(readRule(f, rule) == 0);
+    }
+
+    // nobody consumes the channel
+    CHECK(!RuleChannel::bound("engine"));
+    CHECK(!RuleChannel::push("engine", rule));
+    CHECK(rule);
+
+    zsock_t* sock = RuleChannel::bind("engine");
+    REQUIRE(sock);
+    CHECK(RuleChannel::bind("other") == NULL);
+    CHECK(RuleChannel::bound("engine"));
+    CHECK(!RuleChannel::bound("other"));
+
+    // wrong address
+    CHECK(!RuleChannel::push("other", rule));
+    CHECK(rule);
+
+    CHECK(RuleChannel::push("engine", rule));
+    CHECK(!rule);
+
+    zpoller_t* poller = zpoller_new(sock, NULL);
+    REQUIRE(poller);
+    CHECK(zpoller_wait(poller, 1000) == sock);
+
+    auto rules = RuleChannel::take();
+    REQUIRE(rules.size() == 1);
+    CHECK(rules[0]->name() == "simplethreshold");
+
+    // queue is empty, next push wakes up the consumer again
+    CHECK(RuleChannel::take().empty());
+    CHECK(zpoller_wait(poller, 0) == NULL);
+    CHECK(RuleChannel::push("engine", rules[0]));
+    CHECK(zpoller_wait(poller, 1000) == sock);
+    CHECK(RuleChannel::take().size() == 1);
+
+    zpoller_destroy(&poller);
+    RuleChannel::unbind("engine");
+    CHECK(!RuleChannel::bound("engine"));
+}
@@ -0,0 +1,75 @@
+#include <catch2/catch.hpp>
+#include <fty_log.h>
+#include "src/autoconfig.h"
+#include "src/ruletemplatecache.h"
+
+#include <filesystem>
+#include <fstream>
+
+TEST_CASE("rule template instantiation")
+{
+    std::vector<std::string> replacements = {
+        "ups-1", "GPI1", "DC-1", "datacenter-3", "CRITICAL", "opened", "critical", "UPS 1"};
+
+    RuleTemplate templat("t@__device_ups__.rule",
+        "{\"name\":\"load@__name__\",\"port\":\"__port__\",\"la\":\"__logicalasset__/__logicalasset_iname__\","
+        "\"s\":\"__severity__ __normalstate__ __rule_result__\",\"e\":\"__ename__\",\"x\":\"__unknown__ __\"}");
+    CHECK(templat.instantiate(replacements) ==
+          "{\"name\":\"load@ups-1\",\"port\":\"GPI1\",\"la\":\"DC-1/datacenter-3\","
+          "\"s\":\"CRITICAL opened critical\",\"e\":\"UPS 1\",\"x\":\"__unknown__ __\"}");
+
+    RuleTemplate empty("empty.rule", "");
+    CHECK(empty.instantiate(replacements).empty());
+
+    RuleTemplate edges("edges.rule", "__name____name__");
+    CHECK(edges.instantiate(replacements) == "ups-1ups-1");
+}
+
+TEST_CASE("rule template routing")
+{
+    CHECK(RuleTemplate::isFlexible("{\"flexible\":{\"name\":\"__name__\"}}"));
+    CHECK(RuleTemplate::isFlexible(" \t\n{\r\n  \"flexible\" : {}}"));
+    CHECK(!RuleTemplate::isFlexible("{\"threshold\":{\"rule_name\":\"__name__\",\"flexible\":1}}"));
+    CHECK(!RuleTemplate::isFlexible("x{\"flexible\":{}}"));
+    CHECK(!RuleTemplate::isFlexible("{\"flex"));
+    CHECK(!RuleTemplate::isFlexible(""));
+
+    CHECK(RuleTemplate("f.rule", "{ \"flexible\": {}}").flexible());
+    CHECK(!RuleTemplate("t.rule", "{ \"single\": {}}").flexible());
+}
+
+TEST_CASE("rule template cache")
+{
+    namespace fs = std::filesystem;
+
+    fs::path dir = fs::temp_directory_path() / "fty-alert-engine-template-cache-test";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    {
+        std::ofstream f(dir / "load@__device_ups__.rule");
+        f << "__name__";
+    }
+    Autoconfig::RuleFilePath = dir.string();
+
+    auto templates = RuleTemplateCache::get();
+    REQUIRE(templates->exists());
+    CHECK(templates->all().size() == 1);
+    CHECK(templates->ofType("__device_ups__").size() == 1);
+    CHECK(templates->ofType("__device_epdu__").empty());
+    CHECK(templates->find("load@__device_ups__.rule") != nullptr);
+    CHECK(RuleTemplateCache::get() == templates);
+
+    // adding a template changes the directory, cache reloads
+    {
+        std::ofstream f(dir / "load@__device_epdu__.rule");
+        f << "__name__";
+    }
+    fs::last_write_time(dir, fs::last_write_time(dir) + std::chrono::seconds(1));
+    auto reloaded = RuleTemplateCache::get();
+    CHECK(reloaded != templates);
+    CHECK(reloaded->all().size() == 2);
+    CHECK(reloaded->ofType("__device_epdu__").size() == 1);
+
+    fs::remove_all(dir);
+    CHECK(!RuleTemplateCache::get()->exists());
+}
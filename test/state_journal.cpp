@@ -0,0 +1,161 @@
+#include <catch2/catch.hpp>
+#include <fty_log.h>
+#include "src/autoconfig.h"
+#include "src/statejournal.h"
+
+#include <filesystem>
+#include <fstream>
+
+static AutoConfigurationInfo s_info(const std::string& type, bool configured)
+{
+    AutoConfigurationInfo info;
+    info.type                        = type;
+    info.subtype                     = "genericups";
+    info.operation                   = "update";
+    info.update_ts                   = "2021-01-01T00:00:00Z";
+    info.configured                  = configured;
+    info.date                        = 1234567890123ULL;
+    info.attributes["name"]          = "UPS 1";
+    info.attributes["phases.output"] = "3";
+    return info;
+}
+
+TEST_CASE("state journal")
+{
+    namespace fs = std::filesystem;
+
+    fs::path dir = fs::temp_directory_path() / "fty-alert-engine-state-journal-test";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    const std::string file = (dir / "state").string();
+
+    StateJournal::Devices devices;
+    StateJournal::Rules   rules;
+    {
+        StateJournal state;
+        state.setPath(file);
+        CHECK(state.load(devices, rules) == -1);
+
+        CHECK(state.put("ups-1", s_info("device", false)) == 0);
+        CHECK(state.put("ups-2", s_info("device", false)) == 0);
+        CHECK(state.put("ups-1", s_info("device", true)) == 0);
+        CHECK(state.remove("ups-2") == 0);
+        CHECK(state.records() == 4);
+        CHECK(!fs::exists(file));
+    }
+
+    // journal only
+    {
+        StateJournal state;
+        state.setPath(file);
+        REQUIRE(state.load(devices, rules) == 0);
+        CHECK(state.records() == 4);
+        REQUIRE(devices.size() == 1);
+        const auto& info = devices["ups-1"];
+        CHECK(info.type == "device");
+        CHECK(info.subtype == "genericups");
+        CHECK(info.operation == "update");
+        CHECK(info.update_ts == "2021-01-01T00:00:00Z");
+        CHECK(info.configured);
+        CHECK(info.date == 1234567890123ULL);
+        CHECK(info.attributes == s_info("device", true).attributes);
+
+        // snapshot plus journal
+        CHECK(state.compact(devices, rules) == 0);
+        CHECK(state.records() == 0);
+        CHECK(!fs::exists(file + ".journal"));
+        CHECK(state.put("epdu-1", s_info("device", false)) == 0);
+    }
+    {
+        StateJournal state;
+        state.setPath(file);
+        devices.clear();
+        REQUIRE(state.load(devices, rules) == 0);
+        CHECK(state.records() == 1);
+        CHECK(devices.size() == 2);
+        CHECK(devices.count("ups-1") == 1);
+        CHECK(devices.count("epdu-1") == 1);
+    }
+
+    // torn record at the end of the journal is dropped, later appends are replayed
+    {
+        std::ofstream f(file + ".journal", std::ios::app | std::ios::binary);
+        f.write("\x40\x00\x00\x00garbage", 11);
+    }
+    {
+        StateJournal state;
+        state.setPath(file);
+        devices.clear();
+        REQUIRE(state.load(devices, rules) == 0);
+        CHECK(devices.size() == 2);
+        CHECK(state.remove("epdu-1") == 0);
+    }
+    {
+        StateJournal state;
+        state.setPath(file);
+        devices.clear();
+        REQUIRE(state.load(devices, rules) == 0);
+        CHECK(devices.size() == 1);
+        CHECK(devices.count("ups-1") == 1);
+        CHECK(!state.needsCompaction(devices.size()));
+    }
+
+    // rules generated for the devices
+    {
+        StateJournal state;
+        state.setPath(file);
+        REQUIRE(state.load(devices, rules) == 0);
+        CHECK(rules.empty());
+        GeneratedRule rule;
+        rule.hash = 42;
+        rule.name = "load.default@ups-1";
+        rule.dest = "fty-alert-engine";
+        CHECK(state.putRules("ups-1", {{"load.default@__device_ups__.rule", rule}}) == 0);
+        CHECK(state.putRules("epdu-2", {{"load.default@__device_epdu__.rule", rule}}) == 0);
+        CHECK(state.remove("epdu-2") == 0);
+    }
+    {
+        StateJournal state;
+        state.setPath(file);
+        REQUIRE(state.load(devices, rules) == 0);
+        REQUIRE(rules.size() == 1);
+        REQUIRE(rules["ups-1"].size() == 1);
+        const GeneratedRule& rule = rules["ups-1"]["load.default@__device_ups__.rule"];
+        CHECK(rule.hash == 42);
+        CHECK(rule.name == "load.default@ups-1");
+        CHECK(rule.dest == "fty-alert-engine");
+
+        // rules are in the snapshot, devices without rules are not
+        rules["ups-2"] = {};
+        CHECK(state.compact(devices, rules) == 0);
+    }
+    {
+        StateJournal state;
+        state.setPath(file);
+        REQUIRE(state.load(devices, rules) == 0);
+        CHECK(state.records() == 0);
+        CHECK(rules.size() == 1);
+        CHECK(rules["ups-1"]["load.default@__device_ups__.rule"].hash == 42);
+        CHECK(state.putRules("ups-1", {}) == 0);
+    }
+    {
+        StateJournal state;
+        state.setPath(file);
+        REQUIRE(state.load(devices, rules) == 0);
+        CHECK(devices.size() == 1);
+        CHECK(rules.empty());
+    }
+
+    // JSON state of previous versions is left to the caller
+    {
+        std::ofstream f(file, std::ios::trunc);
+        f << "{}";
+    }
+    {
+        StateJournal state;
+        state.setPath(file);
+        CHECK(state.load(devices, rules) == -2);
+    }
+
+    fs::remove_all(dir);
+}